@@ -7,6 +7,7 @@
 #include <QStackedWidget>
 #include <QStringListModel>
 #include <QDesktopServices>
+#include <QLabel>
 #include "HarpoonClient.hpp"
 #include "models/irc/IrcServerTreeModel.hpp"
 #include "version.hpp"
@@ -99,6 +100,30 @@ ChatUi::ChatUi(HarpoonClient& client,
                 topicView_->setText(topic);
         });
 
+    // connection state and latency
+    connectionStateLabel_ = new QLabel(this);
+    clientUi_.statusbar->addWidget(connectionStateLabel_);
+    connect(&client, &HarpoonClient::connectionStateChanged, [this](int core, ConnectionState state) {
+            QString text;
+            switch (state) {
+            case ConnectionState::Disconnected:   text = "Disconnected"; break;
+            case ConnectionState::Connecting:     text = "Connecting..."; break;
+            case ConnectionState::Authenticating: text = "Logging in..."; break;
+            case ConnectionState::Syncing:        text = "Synchronizing..."; break;
+            case ConnectionState::Live:           text = "Connected"; break;
+            case ConnectionState::BackingOff:     text = "Connection lost, waiting to reconnect"; break;
+            }
+            coreStates_[core] = text;
+            updateStatusLabels();
+        });
+
+    latencyLabel_ = new QLabel(this);
+    clientUi_.statusbar->addPermanentWidget(latencyLabel_);
+    connect(&client, &HarpoonClient::latencyChanged, [this](int core, int rtt) {
+            coreLatencies_[core] = rtt;
+            updateStatusLabels();
+        });
+
     channelView_->setContextMenuPolicy(Qt::CustomContextMenu);
     connect(channelView_, &QWidget::customContextMenuRequested, this, &ChatUi::showChannelContextMenu);
 
@@ -161,13 +186,16 @@ void ChatUi::showChannelContextMenu(const QPoint&) {
 
     QMenu menu(this);
 
-    QAction *actionJoin = nullptr, *actionPart = nullptr, *actionDelete = nullptr;
+    QAction *actionJoin = nullptr, *actionPart = nullptr, *actionDelete = nullptr, *actionFilter = nullptr;
 
     if (channel->getDisabled()) {
         actionJoin = menu.addAction("Join");
     } else {
         actionPart = menu.addAction("Part");
     }
+    actionFilter = menu.addAction("Hide joins/parts");
+    actionFilter->setCheckable(true);
+    actionFilter->setChecked(channel->getJoinPartFilter() > 0);
     actionDelete = menu.addAction("Delete");
 
     QAction* selected = menu.exec(QCursor::pos());
@@ -177,6 +205,8 @@ void ChatUi::showChannelContextMenu(const QPoint&) {
         client_.sendMessage(server.get(), channel.get(), "/join "+channel->getName());
     } else if (selected == actionPart) {
         client_.sendMessage(server.get(), channel.get(), "/part "+channel->getName());
+    } else if (selected == actionFilter) {
+        client_.sendMessage(server.get(), channel.get(), channel->getJoinPartFilter() > 0 ? "/filter none" : "/filter joinpart");
     } else if (selected == actionDelete) {
         client_.sendMessage(server.get(), channel.get(), "/deletechannel "+channel->getName());
     }
@@ -208,6 +238,22 @@ void ChatUi::onChannelViewSelection(const QModelIndex& index) {
     }
 }
 
+void ChatUi::updateStatusLabels() {
+    // with several cores every entry is prefixed with its core index
+    bool multiCore = coreStates_.size() > 1 || coreLatencies_.size() > 1;
+    QStringList states;
+    for (auto it = coreStates_.constBegin(); it != coreStates_.constEnd(); ++it)
+        states << (multiCore ? QString("[%1] %2").arg(it.key()).arg(it.value()) : it.value());
+    connectionStateLabel_->setText(states.join(", "));
+
+    QStringList latencies;
+    for (auto it = coreLatencies_.constBegin(); it != coreLatencies_.constEnd(); ++it) {
+        if (it.value() < 0) continue;
+        latencies << (multiCore ? QString("[%1] %2 ms").arg(it.key()).arg(it.value()) : QString("%1 ms").arg(it.value()));
+    }
+    latencyLabel_->setText(latencies.isEmpty() ? QString() : "Latency: " + latencies.join(", "));
+}
+
 void ChatUi::activateChannel(IrcChannel* channel) {
     if (channel != nullptr) {
         setWindowTitle(QString("Harpoon - ") + channel->getName());
@@ -220,6 +266,7 @@ void ChatUi::activateChannel(IrcChannel* channel) {
         backlogViews_->setCurrentWidget(channel->getBacklogView());
         topicView_->setText(channel->getTopic());
         channel->activate();
+        client_.activateChannel(channel);
     } else {
         setWindowTitle("Harpoon");
         activeChannel_ = nullptr;
@@ -2,6 +2,7 @@
 #define CHATUI_H
 
 #include <QSettings>
+#include <QMap>
 #include <list>
 #include <memory>
 #include "SettingsDialog.hpp"
@@ -19,6 +20,7 @@ class QTreeView;
 class QTableView;
 class QLineEdit;
 class QStackedWidget;
+class QLabel;
 
 
 class ChatUi : public QMainWindow {
@@ -39,6 +41,10 @@ class ChatUi : public QMainWindow {
     QStackedWidget* backlogViews_;
     QLineEdit* messageInputView_;
     IrcChannel* activeChannel_;
+    QLabel* connectionStateLabel_;
+    QLabel* latencyLabel_;
+    QMap<int, QString> coreStates_; // by core index
+    QMap<int, int> coreLatencies_;
 
     QDialog bouncerConfigurationDialog_;
     SettingsDialog settingsDialog_;
@@ -56,6 +62,7 @@ private:
     void activateChannel(IrcChannel* channel);
     void showConfigureNetworksDialog();
     void showConfigureBouncerDialog();
+    void updateStatusLabels();
 
 signals:
     void sendMessage(IrcServer* server, IrcChannel* channel, const QString& message);
@@ -1,5 +1,6 @@
 #include "HarpoonClient.hpp"
 #include "moc_HarpoonClient.cpp"
+#include "HarpoonConnection.hpp"
 
 #include "irc/IrcServer.hpp"
 #include "models/irc/IrcServerTreeModel.hpp"
@@ -10,99 +11,482 @@
 
 #include <limits>
 #include <algorithm>
-#include <sstream>
 #include <QDebug>
-#include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
-#include <QJsonValue>
+#include <QSet>
+#include <QRegExp>
 
 QT_USE_NAMESPACE
 
 
+// protocol extensions this client can make use of
+static const QStringList clientCaps{
+    "cbor",
+    "batch",
+    "subscribe",
+    "filter",
+    "dict",
+    "columnar",
+};
+
+// reconnect delays grow exponentially up to the cap, the actual delay is
+// drawn uniformly below that so clients don't reconnect in lockstep
+static const int reconnectBaseDelay = 1000;
+static const int reconnectMaxDelay = 60000;
+
+// events the standby keeps for replay, covers a few seconds of traffic
+static const size_t standbyEventLimit = 1024;
+
+// milliseconds of backlog application per event loop iteration
+static const int backlogSliceBudget = 4;
+// backlog lines inserted with one addMessages call
+static const size_t backlogChunkSize = 64;
+// lines per gap fill request, a full page asks for the next one
+static const size_t gapPageSize = 500;
+
+
+// ws://a,ws://b or whitespace separated
+static QList<QUrl> parseEndpoints(const QString& hosts) {
+    QList<QUrl> urls;
+    // empty parts are skipped by hand, the split flags moved between qt versions
+    for (auto& host : hosts.split(QRegExp("[\\s,]+"))) {
+        if (!host.isEmpty())
+            urls.push_back(QUrl(host));
+    }
+    if (urls.isEmpty())
+        urls.push_back(QUrl("ws://localhost:8080/ws"));
+    return urls;
+}
+
+// only events that carry an id can be deduplicated
+static bool eventId(const HarpoonEvent& event, size_t& id) {
+    switch (event.type) {
+    case HarpoonEventType::IrcTopic:
+        id = static_cast<const TopicEvent&>(event).id; return true;
+    case HarpoonEventType::IrcChat:
+    case HarpoonEventType::IrcNotice:
+    case HarpoonEventType::IrcAction:
+        id = static_cast<const ChatEvent&>(event).id; return true;
+    case HarpoonEventType::IrcMode:
+        id = static_cast<const ModeEvent&>(event).id; return true;
+    case HarpoonEventType::IrcJoin:
+        id = static_cast<const JoinEvent&>(event).id; return true;
+    case HarpoonEventType::IrcPart:
+        id = static_cast<const PartEvent&>(event).id; return true;
+    case HarpoonEventType::IrcNickChange:
+        id = static_cast<const NickChangeEvent&>(event).id; return true;
+    case HarpoonEventType::IrcQuit:
+        id = static_cast<const QuitEvent&>(event).id; return true;
+    case HarpoonEventType::IrcKick:
+        id = static_cast<const KickEvent&>(event).id; return true;
+    default:
+        return false;
+    }
+}
+
+
 HarpoonClient::HarpoonClient(IrcServerTreeModel& serverTreeModel,
                              SettingsTypeModel& settingsTypeModel)
+    : HarpoonClient(serverTreeModel, settingsTypeModel, 0,
+                    QString(), QString(), QString())
+{
+    username_ = settings_.value("username", "user").toString();
+    password_ = settings_.value("password", "password").toString();
+    harpoonUrls_ = parseEndpoints(settings_.value("host", "ws://localhost:8080/ws").toString());
+
+    // networks sharded over further cores, each gets its own connections,
+    // network thread and backoff, their servers are merged into the tree
+    int coreCount = settings_.beginReadArray("cores");
+    for (int i = 0; i < coreCount; ++i) {
+        settings_.setArrayIndex(i);
+        std::unique_ptr<HarpoonClient> core{new HarpoonClient(serverTreeModel, settingsTypeModel, i + 1,
+                                                              settings_.value("username").toString(),
+                                                              settings_.value("password").toString(),
+                                                              settings_.value("host").toString())};
+        connect(core.get(), &HarpoonClient::topicChanged, this, &HarpoonClient::topicChanged);
+        connect(core.get(), &HarpoonClient::latencyChanged, this, &HarpoonClient::latencyChanged);
+        connect(core.get(), &HarpoonClient::connectionStateChanged, this, &HarpoonClient::connectionStateChanged);
+        cores_.push_back(std::move(core));
+    }
+    settings_.endArray();
+}
+
+HarpoonClient::HarpoonClient(IrcServerTreeModel& serverTreeModel,
+                             SettingsTypeModel& settingsTypeModel,
+                             int core,
+                             const QString& username,
+                             const QString& password,
+                             const QString& hosts)
     : shutdown_{false}
+    , core_{core}
     , serverTreeModel_{serverTreeModel}
     , settingsTypeModel_{settingsTypeModel}
+    , activeEndpoint_{0}
+    , standbyEndpoint_{1}
+    , connection_{new HarpoonConnection}
+    , standby_{new HarpoonConnection}
+    , standbyReady_{false}
+    , standbyAttempts_{0}
+    , lastEventId_{std::numeric_limits<size_t>::max()}
+    , resuming_{false}
+    , replaying_{false}
+    , connectionState_{ConnectionState::Disconnected}
+    , reconnectAttempts_{0}
+    , reconnectRandom_{std::random_device{}()}
+    , subscriptionSize_{8}
     , settings_("_0x17de", "HarpoonClient")
 {
-    connect(&ws_, &QWebSocket::connected, this, &HarpoonClient::onConnected);
-    connect(&ws_, &QWebSocket::textMessageReceived, this, &HarpoonClient::onTextMessage);
-    connect(&ws_, &QWebSocket::binaryMessageReceived, this, &HarpoonClient::onBinaryMessage);
+    // websocket keepalive, the connection is dropped when a pong is overdue
+    int pingInterval = settings_.value("pingInterval", 30000).toInt();
+    int pongTimeout = settings_.value("pongTimeout", 10000).toInt();
+
+    // the websockets and frame decoding live on the network thread
+    for (HarpoonConnection* connection : {connection_, standby_}) {
+        connection->moveToThread(&networkThread_);
+        connect(connection, &HarpoonConnection::eventsAvailable, this, [this, connection] {
+                onEventsAvailable(connection);
+            }, Qt::QueuedConnection);
+        QMetaObject::invokeMethod(connection, "setKeepAlive", Qt::QueuedConnection, Q_ARG(int, pingInterval), Q_ARG(int, pongTimeout));
+        connect(&networkThread_, &QThread::finished, connection, &QObject::deleteLater);
+    }
     connect(&reconnectTimer_, &QTimer::timeout, this, &HarpoonClient::onReconnectTimer);
-    connect(&pingTimer_, &QTimer::timeout, this, &HarpoonClient::onPingTimer);
+    connect(&standbyReconnectTimer_, &QTimer::timeout, this, &HarpoonClient::onStandbyReconnectTimer);
+    connect(&backlogTimer_, &QTimer::timeout, this, &HarpoonClient::onBacklogTimer);
     connect(&serverTreeModel, &IrcServerTreeModel::newChannel, this, &HarpoonClient::onNewChannel);
 
     reconnectTimer_.setSingleShot(true);
-    username_ = settings_.value("username", "user").toString();
-    password_ = settings_.value("password", "password").toString();
-    harpoonUrl_ = settings_.value("host", "ws://localhost:8080/ws").toString();
+    standbyReconnectTimer_.setSingleShot(true);
+    backlogTimer_.setSingleShot(true);
+    subscriptionSize_ = std::max(1, settings_.value("subscribedChannels", 8).toInt());
+    // the channels viewed last session are subscribed right at login
+    int subscriptionCount = settings_.beginReadArray(QString("subscriptions/%1").arg(core_));
+    for (int i = 0; i < subscriptionCount && i < subscriptionSize_; ++i) {
+        settings_.setArrayIndex(i);
+        recentChannels_.push_back(qMakePair(settings_.value("server").toString(),
+                                            settings_.value("channel").toString()));
+    }
+    settings_.endArray();
+    username_ = username;
+    password_ = password;
+    harpoonUrls_ = parseEndpoints(hosts);
+
+    networkThread_.start();
 }
 
 HarpoonClient::~HarpoonClient() {
+    cores_.clear();
     shutdown_ = true;
+    // lets a producer blocked on a full queue give up before we wait for it
+    networkThread_.requestInterruption();
+    // sockets and timers belong to the network thread, stop them there
+    for (HarpoonConnection* connection : {connection_, standby_})
+        QMetaObject::invokeMethod(connection, "shutdown", Qt::BlockingQueuedConnection);
+    networkThread_.quit();
+    networkThread_.wait(); // finished deletes the connections on their thread
 }
 
 void HarpoonClient::reconnect(const QString& lusername,
                               const QString& lpassword,
                               const QString& host) {
     qDebug() << "reconnect";
-    ws_.close();
+    reconnectAttempts_ = 0; // new settings, retry quickly
+    resumeToken_.clear(); // the session may belong to another user
+    lastEventId_ = std::numeric_limits<size_t>::max(); // ids of another bouncer don't compare
+    QMetaObject::invokeMethod(connection_, "close", Qt::QueuedConnection);
     username_ = lusername;
     password_ = lpassword;
-    harpoonUrl_ = host;
+    harpoonUrls_ = parseEndpoints(host);
+    activeEndpoint_ = 0;
+    standbyEndpoint_ = 1;
+
+    // restart the standby against the new endpoints
+    QMetaObject::invokeMethod(standby_, "close", Qt::QueuedConnection);
+    standbyReady_ = false;
+    standbyAttempts_ = 0;
+    standbyResumeToken_.clear();
+    standbyEvents_.clear();
+    standbyReconnectTimer_.stop();
+    if (harpoonUrls_.size() > 1)
+        standbyReconnectTimer_.start(0);
+
+    // nothing to close while waiting, connect right away
+    if (connectionState_ == ConnectionState::BackingOff
+        || connectionState_ == ConnectionState::Disconnected) {
+        reconnectTimer_.stop();
+        onReconnectTimer();
+    }
 }
 
 QSettings& HarpoonClient::getSettings() {
     return settings_;
 }
 
+ConnectionState HarpoonClient::getConnectionState() const {
+    return connectionState_;
+}
+
+int HarpoonClient::getCore() const {
+    return core_;
+}
+
+void HarpoonClient::setConnectionState(ConnectionState state) {
+    if (state == connectionState_) return;
+    connectionState_ = state;
+    if (state == ConnectionState::Live) {
+        reconnectAttempts_ = 0;
+        if (downtime_.isValid()) {
+            qDebug() << "reconnected after" << downtime_.elapsed() << "ms";
+            downtime_.invalidate();
+        }
+    }
+    emit connectionStateChanged(core_, state);
+}
+
+int HarpoonClient::backoffDelay(int& attempts) {
+    int ceiling = reconnectMaxDelay;
+    if (attempts < 16)
+        ceiling = std::min(reconnectMaxDelay, reconnectBaseDelay << attempts);
+    ++attempts;
+
+    std::uniform_int_distribution<int> delay{0, ceiling};
+    return delay(reconnectRandom_);
+}
+
+void HarpoonClient::scheduleReconnect() {
+    int delayMs = backoffDelay(reconnectAttempts_);
+    qDebug() << "reconnecting in" << delayMs << "ms";
+
+    setConnectionState(ConnectionState::BackingOff);
+    reconnectTimer_.start(delayMs);
+
+    // resolve the bouncer while waiting, the lookup is cached for a while
+    if (settings_.value("prewarmDns", true).toBool())
+        QMetaObject::invokeMethod(connection_, "prewarm", Qt::QueuedConnection, Q_ARG(QUrl, harpoonUrls_[activeEndpoint_]));
+}
+
+void HarpoonClient::scheduleStandbyReconnect() {
+    if (harpoonUrls_.size() < 2 || shutdown_) return;
+
+    // with more than two endpoints try the next one that isn't active
+    if (harpoonUrls_.size() > 2) {
+        do {
+            standbyEndpoint_ = (standbyEndpoint_ + 1) % harpoonUrls_.size();
+        } while (standbyEndpoint_ == activeEndpoint_);
+    }
+    standbyReconnectTimer_.start(backoffDelay(standbyAttempts_));
+}
+
 void HarpoonClient::run() {
-    ws_.open(harpoonUrl_);
+    for (auto& core : cores_)
+        core->run();
+
+    setConnectionState(ConnectionState::Connecting);
+    QMetaObject::invokeMethod(connection_, "open", Qt::QueuedConnection, Q_ARG(QUrl, harpoonUrls_[activeEndpoint_]));
+    if (harpoonUrls_.size() > 1)
+        onStandbyReconnectTimer();
 }
 
 void HarpoonClient::onReconnectTimer() {
-    ws_.open(harpoonUrl_);
+    setConnectionState(ConnectionState::Connecting);
+    QMetaObject::invokeMethod(connection_, "open", Qt::QueuedConnection, Q_ARG(QUrl, harpoonUrls_[activeEndpoint_]));
+}
+
+void HarpoonClient::onStandbyReconnectTimer() {
+    if (harpoonUrls_.size() < 2) return;
+    QMetaObject::invokeMethod(standby_, "open", Qt::QueuedConnection, Q_ARG(QUrl, harpoonUrls_[standbyEndpoint_]));
+}
+
+void HarpoonClient::sendText(const QString& message) {
+    QMetaObject::invokeMethod(connection_, "sendTextMessage", Qt::QueuedConnection, Q_ARG(QString, message));
+}
+
+void HarpoonClient::sendCommand(const QJsonObject& root) {
+    // serialized on the network thread in the negotiated encoding
+    QMetaObject::invokeMethod(connection_, "sendCommand", Qt::QueuedConnection, Q_ARG(QJsonObject, root));
 }
 
-void HarpoonClient::onPingTimer() {
-    qDebug() << "ping";
-    ws_.sendTextMessage("{\"cmd\":\"ping\"}");
+void HarpoonClient::onConnected(const ConnectedEvent& event) {
+    qDebug() << "connected, handshake took" << event.handshakeTime << "ms";
+    setConnectionState(ConnectionState::Authenticating);
+
+    // with a resume token the bouncer replays what we missed instead of
+    // sending a new chatlist, only possible if we still have the old state
+    size_t lastId = irc_getLastEventId();
+    resuming_ = !resumeToken_.isEmpty() && lastId != std::numeric_limits<size_t>::max();
+    if (resuming_)
+        sendText(QString("RESUME ") + resumeToken_ + " " + QString::number(lastId) + "\n");
+    else
+        sendLogin();
 }
 
-void HarpoonClient::onConnected() {
-    qDebug() << "connected";
+void HarpoonClient::sendLogin() {
     QString loginCommand = QString("LOGIN ") + username_ + " " + password_ + "\n";
-    ws_.sendTextMessage(loginCommand);
-    pingTimer_.start(60000);
+    sendText(loginCommand);
+
+    // don't wait for the login response, the bouncer handles commands in order
+    // and the responses are dropped if the login fails
+    sendQuerySettings();
+    irc_requestMissedBacklog();
+}
+
+void HarpoonClient::sendQuerySettings() {
+    QJsonObject root;
+    root["cmd"] = "querysettings";
+    sendCommand(root);
 }
 
 void HarpoonClient::onDisconnected() {
-    pingTimer_.stop();
+    // socket errors and the close itself may both report the same loss
+    if (connectionState_ == ConnectionState::BackingOff
+        || connectionState_ == ConnectionState::Disconnected)
+        return;
+
     qDebug() << "disconnected";
-    std::list<std::shared_ptr<IrcServer>> emptyServerList;
-    serverTreeModel_.resetServers(emptyServerList);
-    std::list<QString> emptyTypeList;
-    settingsTypeModel_.resetTypes(emptyTypeList);
-    if (!shutdown_)
-        reconnectTimer_.start(3000);
+    if (!downtime_.isValid())
+        downtime_.start();
+    emit latencyChanged(core_, -1);
+
+    if (standbyReady_ && !shutdown_) {
+        promoteStandby();
+        return;
+    }
+
+    // keep channels, backlogs and users, the next chatlist is reconciled against them
+    serverTreeModel_.setStale(core_, true);
+    for (auto& server : serverTreeModel_.getServers()) {
+        if (server->getCore() != core_) continue;
+        for (auto& channel : server->getChannelModel().getChannels())
+            channel->resetBacklogRequest(); // lost with the connection
+    }
+    gapRequests_.clear();
+    if (shutdown_)
+        setConnectionState(ConnectionState::Disconnected);
+    else
+        scheduleReconnect();
+}
+
+void HarpoonClient::onEventsAvailable(HarpoonConnection* connection) {
+    connection->acknowledgeEvents();
+
+    // a failover may swap the roles while draining
+    std::unique_ptr<HarpoonEvent> event;
+    while (connection->takeEvent(event)) {
+        if (connection == connection_)
+            handleEvent(*event);
+        else
+            handleStandbyEvent(std::move(event));
+    }
+}
+
+void HarpoonClient::handleStandbyEvent(std::unique_ptr<HarpoonEvent>&& event) {
+    switch (event->type) {
+    case HarpoonEventType::Connected:
+        QMetaObject::invokeMethod(standby_, "sendTextMessage", Qt::QueuedConnection,
+                                  Q_ARG(QString, QString("LOGIN ") + username_ + " " + password_ + "\n"));
+        break;
+    case HarpoonEventType::Disconnected:
+        if (standbyReady_ || !standbyReconnectTimer_.isActive()) {
+            qDebug() << "standby disconnected";
+            standbyReady_ = false;
+            standbyEvents_.clear();
+            scheduleStandbyReconnect();
+        }
+        break;
+    case HarpoonEventType::Login:
+        handleStandbyLogin(static_cast<const LoginEvent&>(*event));
+        break;
+    case HarpoonEventType::Latency:
+    case HarpoonEventType::IrcSettings:
+    case HarpoonEventType::IrcChatList:
+    case HarpoonEventType::IrcBacklogResponse:
+        break; // the active connection's state is used
+    default:
+        if (!standbyReady_) break;
+        standbyEvents_.push_back(std::move(event));
+        if (standbyEvents_.size() > standbyEventLimit) {
+            // a replay must reach back to the standby's login, log in again
+            qDebug() << "standby buffer full, restarting standby";
+            standbyReady_ = false;
+            standbyEvents_.clear();
+            QMetaObject::invokeMethod(standby_, "close", Qt::QueuedConnection);
+        }
+    }
 }
 
-void HarpoonClient::onTextMessage(const QString& message) {
-    qDebug() << message;
-    QJsonDocument doc = QJsonDocument::fromJson(message.toUtf8());
-    handleCommand(doc);
+void HarpoonClient::handleStandbyLogin(const LoginEvent& event) {
+    if (!event.success) {
+        qWarning() << "standby login failed";
+        QMetaObject::invokeMethod(standby_, "close", Qt::QueuedConnection);
+        return;
+    }
+
+    standbyReady_ = true;
+    standbyAttempts_ = 0;
+    standbyResumeToken_ = event.resumeToken;
+    standbyCaps_.clear();
+    for (auto& cap : event.caps) {
+        if (clientCaps.contains(cap))
+            standbyCaps_.push_back(cap);
+    }
+    if (!standbyCaps_.isEmpty())
+        QMetaObject::invokeMethod(standby_, "enableCapabilities", Qt::QueuedConnection, Q_ARG(QStringList, standbyCaps_));
+    if (standbyCaps_.contains("subscribe")) // buffer the same channels as the active connection
+        QMetaObject::invokeMethod(standby_, "sendCommand", Qt::QueuedConnection, Q_ARG(QJsonObject, irc_subscribeCommand()));
+    if (standbyCaps_.contains("filter")) // and filter them the same way
+        irc_sendFilters(standby_);
+    qDebug() << "standby ready on" << harpoonUrls_[standbyEndpoint_];
+
+    // the active endpoint is down, don't wait for its backoff
+    if (connectionState_ == ConnectionState::BackingOff
+        || connectionState_ == ConnectionState::Connecting)
+        promoteStandby();
 }
 
-void HarpoonClient::onBinaryMessage(const QByteArray& data) {
-    qDebug() << data;
-    QJsonDocument doc = QJsonDocument::fromJson(data);
-    handleCommand(doc);
+void HarpoonClient::promoteStandby() {
+    qDebug() << "failing over to" << harpoonUrls_[standbyEndpoint_];
+    reconnectTimer_.stop();
+    std::swap(connection_, standby_);
+    std::swap(activeEndpoint_, standbyEndpoint_);
+    resumeToken_ = standbyResumeToken_;
+    enabledCaps_ = standbyCaps_;
+    resuming_ = false;
+    standbyReady_ = false;
+
+    // the old connection becomes the standby for the failed endpoint
+    QMetaObject::invokeMethod(standby_, "close", Qt::QueuedConnection);
+    scheduleStandbyReconnect();
+
+    serverTreeModel_.setStale(core_, false);
+    setConnectionState(ConnectionState::Live);
+
+    // replay everything the standby saw on top of the current tree; most of
+    // it was applied already, so the id check is off and the backlog views
+    // drop the lines they have
+    std::deque<std::unique_ptr<HarpoonEvent>> events;
+    events.swap(standbyEvents_);
+    replaying_ = true;
+    for (auto& event : events)
+        handleEvent(*event);
+    replaying_ = false;
+
+    // backlog lines are deduplicated by the views, this only closes gaps
+    gapRequests_.clear(); // pages in flight were lost with the old connection
+    sendQuerySettings();
+    irc_requestMissedBacklog();
 }
 
 void HarpoonClient::onNewChannel(std::shared_ptr<IrcChannel> channel) {
+    auto server = channel->getServer().lock();
+    if (!server || server->getCore() != core_) return; // handled by its own core
     connect(channel.get(), &IrcChannel::backlogRequest, this, &HarpoonClient::backlogRequest);
+
+    // filters are kept across restarts, the bouncer learns them again here
+    int minutes = settings_.value(irc_filterKey(server->getId(), channel->getName()), 0).toInt();
+    if (minutes > 0) {
+        channel->setJoinPartFilter(minutes);
+        irc_sendFilter(server.get(), channel.get());
+    }
 }
 
 void HarpoonClient::backlogRequest(IrcChannel* channel) {
@@ -118,11 +502,19 @@ void HarpoonClient::backlogRequest(IrcChannel* channel) {
     if (firstId != std::numeric_limits<size_t>::max())
         root["from"] = std::to_string(channel->getFirstId()).c_str();
 
-    QString json = QJsonDocument{root}.toJson(QJsonDocument::JsonFormat::Compact);
-    ws_.sendTextMessage(json);
+    sendCommand(root);
 }
 
 void HarpoonClient::sendMessage(IrcServer* server, IrcChannel* channel, const QString& message) {
+    if (server && server->getCore() != core_) {
+        // the server lives on another core, send through its connection
+        for (auto& core : cores_) {
+            if (core->getCore() == server->getCore())
+                core->sendMessage(server, channel, message);
+        }
+        return;
+    }
+
     // TODO: only irc works yet.
     if (message.count() == 0)
         return; // don't send empty messages
@@ -292,6 +684,25 @@ void HarpoonClient::sendMessage(IrcServer* server, IrcChannel* channel, const QS
                 root["protocol"] = "irc";
                 root["server"] = server->getId();
                 root["channel"] = channelName;
+            } else if (cmd == "filter") { // hide join/part/quit lines
+                // cmd joinpart [minutes] | cmd none
+                if (parts.count() < 2)
+                    return;
+
+                int minutes = 0;
+                if (parts.at(1) == "joinpart")
+                    minutes = parts.count() >= 3 ? std::max(1, parts.at(2).toInt()) : 10;
+                else if (parts.at(1) != "none")
+                    return;
+
+                channel->setJoinPartFilter(minutes);
+                QString key = irc_filterKey(server->getId(), channel->getName());
+                if (minutes > 0)
+                    settings_.setValue(key, minutes);
+                else
+                    settings_.remove(key);
+                irc_sendFilter(server, channel);
+                return; // sent to both connections, or only hidden locally
             } else if (cmd == "deletechannel") { // delete channel
                 QString channelName = parts.count() >= 2 ? parts.at(1) : channel->getName();
                 root["cmd"] = "deletechannel";
@@ -306,580 +717,420 @@ void HarpoonClient::sendMessage(IrcServer* server, IrcChannel* channel, const QS
         }
     }
 
-    QString json = QJsonDocument{root}.toJson(QJsonDocument::JsonFormat::Compact);
-    ws_.sendTextMessage(json);
+    sendCommand(root);
 }
 
-void HarpoonClient::handleCommand(const QJsonDocument& doc) {
-    if (!doc.isObject()) return;
-    QJsonObject root = doc.object();
-    QJsonValue cmdValue = root.value("cmd");
-    if (!cmdValue.isString()) return;
+void HarpoonClient::handleEvent(HarpoonEvent& event) {
+    // the caller discards the event afterwards, handlers may move out of it
+    // until the login succeeded every response belongs to a pipelined
+    // command that may have been rejected, drop them
+    if (connectionState_ == ConnectionState::Authenticating) {
+        switch (event.type) {
+        case HarpoonEventType::Connected:
+        case HarpoonEventType::Disconnected:
+        case HarpoonEventType::Latency:
+        case HarpoonEventType::Login:
+            break;
+        default:
+            return;
+        }
+    }
 
-    QJsonValue typeValue = root.value("protocol");
-    QString type = typeValue.isString() ? typeValue.toString() : "";
+    size_t id;
+    if (eventId(event, id)) {
+        bool seen = lastEventId_ != std::numeric_limits<size_t>::max() && id <= lastEventId_;
+        if (seen && !replaying_)
+            return; // already applied
+        if (!seen)
+            lastEventId_ = id;
+    }
 
-    QString cmd = cmdValue.toString();
-    qDebug() << type << ":" << cmd;
-    if (type == "") {
-        if (cmd == "login") {
-            handleLogin(root);
-        }
-    } if (type == "irc") {
-        if (cmd == "chatlist") {
-            irc_handleChatList(root);
-        } else if (cmd == "chat") {
-            irc_handleChat(root, false);
-        } else if (cmd == "userlist") {
-            irc_handleUserList(root);
-        } else if (cmd == "nickchange") {
-            irc_handleNickChange(root);
-        } else if (cmd == "nickmodified") {
-            irc_handleNickModified(root);
-        } else if (cmd == "serveradded") {
-            irc_handleServerAdded(root);
-        } else if (cmd == "serverremoved") {
-            irc_handleServerDeleted(root);
-        } else if (cmd == "hostadded") {
-            irc_handleHostAdded(root);
-        } else if (cmd == "hostdeleted") {
-            irc_handleHostDeleted(root);
-        } else if (cmd == "topic") {
-            irc_handleTopic(root);
-        } else if (cmd == "action") {
-            irc_handleAction(root);
-        } else if (cmd == "mode") {
-            irc_handleMode(root);
-        } else if (cmd == "kick") {
-            irc_handleKick(root);
-        } else if (cmd == "notice") {
-            irc_handleChat(root, true);
-        } else if (cmd == "join") {
-            irc_handleJoin(root);
-        } else if (cmd == "part") {
-            irc_handlePart(root);
-        } else if (cmd == "settings") {
-            irc_handleSettings(root);
-        } else if (cmd == "quit") {
-            irc_handleQuit(root);
-        } else if (cmd == "backlogresponse") {
-            irc_handleBacklogResponse(root);
-        }
+    switch (event.type) {
+    case HarpoonEventType::Connected:
+        onConnected(static_cast<const ConnectedEvent&>(event));
+        break;
+    case HarpoonEventType::Disconnected:
+        onDisconnected();
+        break;
+    case HarpoonEventType::Latency:
+        emit latencyChanged(core_, static_cast<const LatencyEvent&>(event).rtt);
+        break;
+    case HarpoonEventType::Login:
+        handleLogin(static_cast<const LoginEvent&>(event));
+        break;
+    case HarpoonEventType::Batch:
+        handleBatch(static_cast<const BatchEvent&>(event));
+        break;
+    case HarpoonEventType::IrcSettings:
+        irc_handleSettings(static_cast<const SettingsEvent&>(event));
+        break;
+    case HarpoonEventType::IrcChatList:
+        irc_handleChatList(static_cast<const ChatListEvent&>(event));
+        setConnectionState(ConnectionState::Live); // the tree is in sync again
+        break;
+    case HarpoonEventType::IrcUserList:
+        irc_handleUserList(static_cast<const UserListEvent&>(event));
+        break;
+    case HarpoonEventType::IrcTopic:
+        irc_handleTopic(static_cast<const TopicEvent&>(event));
+        break;
+    case HarpoonEventType::IrcChat:
+        irc_handleChat(static_cast<const ChatEvent&>(event), false);
+        break;
+    case HarpoonEventType::IrcNotice:
+        irc_handleChat(static_cast<const ChatEvent&>(event), true);
+        break;
+    case HarpoonEventType::IrcAction:
+        irc_handleAction(static_cast<const ChatEvent&>(event));
+        break;
+    case HarpoonEventType::IrcMode:
+        irc_handleMode(static_cast<const ModeEvent&>(event));
+        break;
+    case HarpoonEventType::IrcJoin:
+        irc_handleJoin(static_cast<const JoinEvent&>(event));
+        break;
+    case HarpoonEventType::IrcPart:
+        irc_handlePart(static_cast<const PartEvent&>(event));
+        break;
+    case HarpoonEventType::IrcNickChange:
+        irc_handleNickChange(static_cast<const NickChangeEvent&>(event));
+        break;
+    case HarpoonEventType::IrcNickModified:
+        irc_handleNickModified(static_cast<const NickModifiedEvent&>(event));
+        break;
+    case HarpoonEventType::IrcQuit:
+        irc_handleQuit(static_cast<const QuitEvent&>(event));
+        break;
+    case HarpoonEventType::IrcKick:
+        irc_handleKick(static_cast<const KickEvent&>(event));
+        break;
+    case HarpoonEventType::IrcServerAdded:
+        irc_handleServerAdded(static_cast<const ServerAddedEvent&>(event));
+        break;
+    case HarpoonEventType::IrcServerDeleted:
+        irc_handleServerDeleted(static_cast<const ServerDeletedEvent&>(event));
+        break;
+    case HarpoonEventType::IrcHostAdded:
+        irc_handleHostAdded(static_cast<const HostAddedEvent&>(event));
+        break;
+    case HarpoonEventType::IrcHostDeleted:
+        irc_handleHostDeleted(static_cast<const HostDeletedEvent&>(event));
+        break;
+    case HarpoonEventType::IrcMembers:
+        irc_handleMembers(static_cast<const MembersEvent&>(event));
+        break;
+    case HarpoonEventType::IrcUnread:
+        irc_handleUnread(static_cast<const UnreadEvent&>(event));
+        break;
+    case HarpoonEventType::IrcBacklogResponse:
+        irc_handleBacklogResponse(std::move(static_cast<BacklogEvent&>(event)));
+        break;
     }
 }
 
-void HarpoonClient::handleLogin(const QJsonObject& root) {
-    auto successValue = root.value("success");
-    if (!successValue.isBool()) return;
-    bool success = successValue.toBool();
-    if (success) {
-        QJsonObject newRoot;
-        newRoot["cmd"] = "querysettings";
-        QString json = QJsonDocument{newRoot}.toJson(QJsonDocument::JsonFormat::Compact);
-        ws_.sendTextMessage(json);
+void HarpoonClient::handleLogin(const LoginEvent& event) {
+    if (event.success) {
+        resumeToken_ = event.resumeToken;
+        enabledCaps_.clear();
+        for (auto& cap : event.caps) {
+            if (clientCaps.contains(cap))
+                enabledCaps_.push_back(cap);
+        }
+        if (!enabledCaps_.isEmpty())
+            QMetaObject::invokeMethod(connection_, "enableCapabilities", Qt::QueuedConnection, Q_ARG(QStringList, enabledCaps_));
+        if (enabledCaps_.contains("subscribe"))
+            sendCommand(irc_subscribeCommand());
+        if (enabledCaps_.contains("filter"))
+            irc_sendFilters(connection_);
+
+        if (resuming_ && event.resumed) {
+            // the missed events follow, no chatlist will be sent
+            sendQuerySettings();
+            serverTreeModel_.setStale(core_, false);
+            setConnectionState(ConnectionState::Live);
+        } else {
+            // a fresh session, the chatlist replaces whatever was applied
+            lastEventId_ = std::numeric_limits<size_t>::max();
+            setConnectionState(ConnectionState::Syncing);
+        }
+        resuming_ = false;
+    } else if (resuming_) {
+        // token expired or unknown, fall back to a full login on this socket
+        qDebug() << "resume rejected";
+        resuming_ = false;
+        resumeToken_.clear();
+        sendLogin();
     } else {
-        // TODO
+        // drop the session, the backoff keeps retries with bad credentials rare
+        qWarning() << "login failed";
+        QMetaObject::invokeMethod(connection_, "close", Qt::QueuedConnection);
     }
 }
 
-void HarpoonClient::irc_handleSettings(const QJsonObject& root) {
-    // TODO: nicks, hasPassword, ipv6, ssl
+void HarpoonClient::handleBatch(const BatchEvent& event) {
+    // every backlog view the batch writes to lays out and scrolls at most once
+    QSet<QPair<QString, QString>> touched; // server id, channel
+    QSet<QString> touchedServers; // nick changes and quits reach every channel
+    auto touch = [&touched](const QString& serverId, const QString& channel) {
+        touched.insert(qMakePair(serverId, channel));
+    };
+    for (auto& batchedEvent : event.events) {
+        const HarpoonEvent& e = *batchedEvent;
+        switch (e.type) {
+        case HarpoonEventType::IrcTopic:
+            touch(static_cast<const TopicEvent&>(e).serverId, static_cast<const TopicEvent&>(e).channel);
+            break;
+        case HarpoonEventType::IrcChat:
+        case HarpoonEventType::IrcNotice:
+        case HarpoonEventType::IrcAction:
+            touch(static_cast<const ChatEvent&>(e).serverId, static_cast<const ChatEvent&>(e).channel);
+            break;
+        case HarpoonEventType::IrcMode:
+            touch(static_cast<const ModeEvent&>(e).serverId, static_cast<const ModeEvent&>(e).channel);
+            break;
+        case HarpoonEventType::IrcJoin:
+            touch(static_cast<const JoinEvent&>(e).serverId, static_cast<const JoinEvent&>(e).channel);
+            break;
+        case HarpoonEventType::IrcPart:
+            touch(static_cast<const PartEvent&>(e).serverId, static_cast<const PartEvent&>(e).channel);
+            break;
+        case HarpoonEventType::IrcKick:
+            touch(static_cast<const KickEvent&>(e).serverId, static_cast<const KickEvent&>(e).channel);
+            break;
+        case HarpoonEventType::IrcBacklogResponse:
+            touch(static_cast<const BacklogEvent&>(e).serverId, static_cast<const BacklogEvent&>(e).channel);
+            break;
+        case HarpoonEventType::IrcNickChange:
+            touchedServers.insert(static_cast<const NickChangeEvent&>(e).serverId);
+            break;
+        case HarpoonEventType::IrcQuit:
+            touchedServers.insert(static_cast<const QuitEvent&>(e).serverId);
+            break;
+        default:
+            break;
+        }
+    }
 
-    auto dataValue = root["data"];
-    if (!dataValue.isObject()) return;
-    QJsonObject data = dataValue.toObject();
+    std::list<std::shared_ptr<IrcChannel>> channels;
+    for (auto& server : serverTreeModel_.getServers()) {
+        if (server->getCore() != core_) continue;
+        bool everyChannel = touchedServers.contains(server->getId());
+        for (auto& channel : server->getChannelModel().getChannels()) {
+            if (everyChannel || touched.contains(qMakePair(server->getId(), channel->getName())))
+                channels.push_back(channel);
+        }
+    }
+    for (auto& channel : channels)
+        channel->getBacklogView()->beginUpdate();
 
-    auto serversValue = data["servers"];
-    if (!serversValue.isObject()) return;
-    auto servers = serversValue.toObject();
+    for (auto& batchedEvent : event.events)
+        handleEvent(*batchedEvent);
 
-    for (auto serverIt = servers.begin(); serverIt != servers.end(); ++serverIt) {
-        QString serverId = serverIt.key();
-        auto serverDataValue = serverIt.value();
-        if (!serverDataValue.isObject()) return;
-        auto serverData = serverDataValue.toObject();
+    for (auto& channel : channels)
+        channel->getBacklogView()->endUpdate();
+}
 
-        std::shared_ptr<IrcServer> server = serverTreeModel_.getServer(serverId);
+void HarpoonClient::irc_handleSettings(const SettingsEvent& event) {
+    // TODO: nicks, hasPassword, ipv6, ssl
 
-        auto hostsValue = serverData["hosts"];
-        auto nicksValue = serverData["nicks"];
-        if (!hostsValue.isObject()) return;
-        if (!nicksValue.isArray()) return;
-        auto hosts = hostsValue.toObject();
-        auto nicks = nicksValue.toArray();
+    for (auto& serverSettings : event.servers) {
+        std::shared_ptr<IrcServer> server = irc_getServer(serverSettings.serverId);
+        if (!server) continue;
 
         std::list<std::shared_ptr<IrcHost>> newHosts;
         std::list<QString> newNicks;
 
-        for (auto hostIt = hosts.begin(); hostIt != hosts.end(); ++hostIt) {
-            QString hostKey = hostIt.key();
-            auto hostDataValue = hostIt.value();
-            if (!hostDataValue.isObject()) return;
-            auto hostData = hostDataValue.toObject();
-
-            auto hasPasswordValue = hostData["hasPassword"];
-            auto ipv6Value = hostData["ipv6"];
-            auto sslValue = hostData["ssl"];
-
-            if (!hasPasswordValue.isBool()) return;
-            if (!ipv6Value.isBool()) return;
-            if (!sslValue.isBool()) return;
-
-            int colonPosition = hostKey.indexOf(":");
-            if (colonPosition == -1) return;
-            QString hostname = hostKey.left(colonPosition);
-            int port = hostKey.right(hostKey.size() - colonPosition - 1).toInt();
-
-            bool ssl = sslValue.toBool();
-            bool ipv6 = ipv6Value.toBool();
-
-            std::shared_ptr<IrcHost> newHost{std::make_shared<IrcHost>(server, hostname, port, ssl, ipv6)};
+        for (auto& host : serverSettings.hosts) {
+            std::shared_ptr<IrcHost> newHost{std::make_shared<IrcHost>(server, host.host, host.port, host.ssl, host.ipv6)};
             newHosts.push_back(newHost);
         }
 
-        for (auto nickIt = nicks.begin(); nickIt != nicks.end(); ++nickIt) {
-            auto nickValue = *nickIt;
-            if (!nickValue.isString()) return;
-            newNicks.push_back(nickValue.toString());
-        }
+        for (auto& nick : serverSettings.nicks)
+            newNicks.push_back(nick);
 
         server->getHostModel().resetHosts(newHosts);
         server->getNickModel().resetNicks(newNicks);
     }
 
-    settingsTypeModel_.newType("irc");
+    if (!settingsTypeModel_.hasType("irc")) // every core reports it
+        settingsTypeModel_.newType("irc");
 }
 
-void HarpoonClient::irc_handleServerAdded(const QJsonObject& root) {
-    auto serverIdValue = root.value("server");
-    auto nameValue = root.value("name");
-
-    if (!serverIdValue.isString()) return;
-    if (!nameValue.isString()) return;
-
-    QString serverId = serverIdValue.toString();
-    QString name = nameValue.toString();
-
-    auto server = std::make_shared<IrcServer>("", serverId, name, true);
+void HarpoonClient::irc_handleServerAdded(const ServerAddedEvent& event) {
+    if (irc_getServer(event.serverId)) return; // replayed after a failover
+    auto server = std::make_shared<IrcServer>("", event.serverId, event.name, true, core_);
     serverTreeModel_.newServer(server);
 }
 
-void HarpoonClient::irc_handleServerDeleted(const QJsonObject& root) {
-    auto serverIdValue = root.value("server");
-
-    if (!serverIdValue.isString()) return;
-
-    QString serverId = serverIdValue.toString();
-    serverTreeModel_.deleteServer(serverId);
+void HarpoonClient::irc_handleServerDeleted(const ServerDeletedEvent& event) {
+    serverTreeModel_.deleteServer(core_, event.serverId);
 }
 
-void HarpoonClient::irc_handleHostAdded(const QJsonObject& root) {
-    auto serverIdValue = root.value("server");
-    auto hostValue = root.value("host");
-    //auto hasPasswordValue = root.value("hasPassword");
-    auto portValue = root.value("port");
-    auto sslValue = root.value("ssl");
-    auto ipv6Value = root.value("ipv6");
-
-    if (!serverIdValue.isString()) return;
-    if (!hostValue.isString()) return;
-    //if (!hasPasswordValue.isString()) return;
-    if (!portValue.isDouble()) return;
-    if (!sslValue.isBool()) return;
-    if (!ipv6Value.isBool()) return;
-
-    QString serverId = serverIdValue.toString();
-    QString hostName = hostValue.toString();
-    //bool hasPassword = hasPasswordValue.toBool();
-    int port = portValue.toInt();
-    bool ssl = sslValue.toBool();
-    bool ipv6 = ipv6Value.toBool();
-
+void HarpoonClient::irc_handleHostAdded(const HostAddedEvent& event) {
     // TODO: has password
 
-    std::shared_ptr<IrcServer> server = serverTreeModel_.getServer(serverId);
-    auto host = std::make_shared<IrcHost>(server, hostName, port, ssl, ipv6);
+    std::shared_ptr<IrcServer> server = irc_getServer(event.serverId);
+    if (!server) return;
+    auto host = std::make_shared<IrcHost>(server, event.host.host, event.host.port, event.host.ssl, event.host.ipv6);
     server->getHostModel().newHost(host);
 }
 
-void HarpoonClient::irc_handleHostDeleted(const QJsonObject& root) {
-    auto serverIdValue = root.value("server");
-    auto hostValue = root.value("host");
-    auto portValue = root.value("port");
-
-    if (!serverIdValue.isString()) return;
-    if (!hostValue.isString()) return;
-    if (!portValue.isDouble()) return;
-
-    QString serverId = serverIdValue.toString();
-    QString host = hostValue.toString();
-    int port = portValue.toInt();
-
-    auto server = serverTreeModel_.getServer(serverId);
-    server->getHostModel().deleteHost(host, port);
+void HarpoonClient::irc_handleHostDeleted(const HostDeletedEvent& event) {
+    auto server = irc_getServer(event.serverId);
+    if (!server) return;
+    server->getHostModel().deleteHost(event.host, event.port);
 }
 
-void HarpoonClient::irc_handleTopic(const QJsonObject& root) {
-    auto idValue = root.value("id");
-    auto timeValue = root.value("time");
-    auto serverIdValue = root.value("server");
-    auto channelNameValue = root.value("channel");
-    auto nickValue = root.value("nick");
-    auto topicValue = root.value("topic");
-
-    if (!idValue.isString()) return;
-    if (!timeValue.isDouble()) return;
-    if (!serverIdValue.isString()) return;
-    if (!channelNameValue.isString()) return;
-    if (!nickValue.isString()) return;
-    if (!topicValue.isString()) return;
-
-    size_t id;
-    std::istringstream(idValue.toString().toStdString()) >> id;
-    double time = timeValue.toDouble();
-    QString serverId = serverIdValue.toString();
-    QString channelName = channelNameValue.toString();
-    QString nick = nickValue.toString();
-    QString topic = topicValue.toString();
-
-    auto server = serverTreeModel_.getServer(serverId);
-    auto* channel = server->getChannelModel().getChannel(channelName);
-    channel->setTopic(id, time, nick, topic);
-    emit topicChanged(channel, topic);
-}
-
-void HarpoonClient::irc_handleUserList(const QJsonObject& root) {
-    //auto idValue = root.value("id");
-    //auto timeValue = root.value("time");
-    auto serverIdValue = root.value("server");
-    auto channelNameValue = root.value("channel");
-    auto usersValue = root.value("users");
-
-    //if (!idValue.isString()) return;
-    //if (!timeValue.isDouble()) return;
-    if (!serverIdValue.isString()) return;
-    if (!channelNameValue.isString()) return;
-    if (!usersValue.isObject()) return;
-
-    //size_t id;
-    //std::istringstream(idValue.toString().toStdString()) >> id;
-    //double time = timeValue.toDouble();
-    QString serverId = serverIdValue.toString();
-    QString channelName = channelNameValue.toString();
-    auto users = usersValue.toObject();
+void HarpoonClient::irc_handleTopic(const TopicEvent& event) {
+    auto server = irc_getServer(event.serverId);
+    if (!server) return;
+    auto* channel = server->getChannelModel().getChannel(event.channel);
+    if (!channel) return;
+    channel->setTopic(event.id, event.time, event.nick, event.topic);
+    emit topicChanged(channel, event.topic);
+}
 
+void HarpoonClient::irc_handleUserList(const UserListEvent& event) {
     std::list<std::shared_ptr<IrcUser>> userList;
-    for (auto userEntryIt = users.begin(); userEntryIt != users.end(); ++userEntryIt) {
-        auto username = userEntryIt.key();
-        auto modeValue = userEntryIt.value();
-        if (!modeValue.isString()) continue;
-        auto mode = modeValue.toString();
-        userList.push_back(std::make_shared<IrcUser>(username, mode));
-    }
+    for (auto& user : event.users)
+        userList.push_back(std::make_shared<IrcUser>(user.nick, user.mode));
 
-    auto server = serverTreeModel_.getServer(serverId);
-    server->getChannelModel().getChannel(channelName)->getUserModel().resetUsers(userList);
+    auto server = irc_getServer(event.serverId);
+    if (!server) return;
+    auto* channel = server->getChannelModel().getChannel(event.channel);
+    if (!channel) return;
+    channel->getUserModel().resetUsers(userList);
 }
 
-void HarpoonClient::irc_handleJoin(const QJsonObject& root) {
-    auto idValue = root.value("id");
-    auto timeValue = root.value("time");
-    auto nickValue = root.value("nick");
-    auto serverIdValue = root.value("server");
-    auto channelNameValue = root.value("channel");
-
-    if (!idValue.isString()) return;
-    if (!timeValue.isDouble()) return;
-    if (!nickValue.isString()) return;
-    if (!serverIdValue.isString()) return;
-    if (!channelNameValue.isString()) return;
-
-    size_t id;
-    std::istringstream(idValue.toString().toStdString()) >> id;
-    double time = timeValue.toDouble();
-    QString nick = nickValue.toString();
-    QString serverId = serverIdValue.toString();
-    QString channelName = channelNameValue.toString();
-
-    std::shared_ptr<IrcServer> server = serverTreeModel_.getServer(serverId);
+void HarpoonClient::irc_handleJoin(const JoinEvent& event) {
+    std::shared_ptr<IrcServer> server = irc_getServer(event.serverId);
+    if (!server) return;
     auto& channelModel = server->getChannelModel();
-    IrcChannel* channel = channelModel.getChannel(channelName);
+    IrcChannel* channel = channelModel.getChannel(event.channel);
 
-    if (IrcUser::stripNick(nick) == server->getActiveNick()) {
+    if (IrcUser::stripNick(event.nick) == server->getActiveNick()) {
         if (channel != nullptr) {
             channel->setDisabled(false);
         } else {
-            std::shared_ptr<IrcChannel> channelPtr{std::make_shared<IrcChannel>(server, channelName, false)};
+            std::shared_ptr<IrcChannel> channelPtr{std::make_shared<IrcChannel>(server, event.channel, false)};
             channel = channelPtr.get();
             channelModel.addChannel(channelPtr);
         }
     }
     if (channel) {
-        channel->addMessage(id, time, "-->", IrcUser::stripNick(nick) + " joined the channel", MessageColor::Event);
-        channel->getUserModel().addUser(std::make_shared<IrcUser>(nick));
+        if (!irc_hideJoinPart(channel, IrcUser::stripNick(event.nick), event.time))
+            channel->addMessage(event.id, event.time, "-->", IrcUser::stripNick(event.nick) + " joined the channel", MessageColor::Event);
+        if (!channel->getUser(IrcUser::stripNick(event.nick))) // may be a replay after a failover
+            channel->getUserModel().addUser(std::make_shared<IrcUser>(event.nick));
     }
 }
 
-void HarpoonClient::irc_handlePart(const QJsonObject& root) {
-    auto idValue = root.value("id");
-    auto timeValue = root.value("time");
-    auto nickValue = root.value("nick");
-    auto serverIdValue = root.value("server");
-    auto channelNameValue = root.value("channel");
-
-    if (!idValue.isString()) return;
-    if (!timeValue.isDouble()) return;
-    if (!nickValue.isString()) return;
-    if (!serverIdValue.isString()) return;
-    if (!channelNameValue.isString()) return;
-
-    size_t id;
-    std::istringstream(idValue.toString().toStdString()) >> id;
-    double time = timeValue.toDouble();
-    QString nick = nickValue.toString();
-    QString serverId = serverIdValue.toString();
-    QString channelName = channelNameValue.toString();
-
-    std::shared_ptr<IrcServer> server = serverTreeModel_.getServer(serverId);
+void HarpoonClient::irc_handlePart(const PartEvent& event) {
+    std::shared_ptr<IrcServer> server = irc_getServer(event.serverId);
+    if (!server) return;
     auto& channelModel = server->getChannelModel();
-    IrcChannel* channel = channelModel.getChannel(channelName);
+    IrcChannel* channel = channelModel.getChannel(event.channel);
 
-    if (IrcUser::stripNick(nick) == server->getActiveNick()) {
+    if (IrcUser::stripNick(event.nick) == server->getActiveNick()) {
         if (channel != nullptr) {
             channel->setDisabled(true);
         } else {
-            std::shared_ptr<IrcChannel> channelPtr{std::make_shared<IrcChannel>(server, channelName, true)};
+            std::shared_ptr<IrcChannel> channelPtr{std::make_shared<IrcChannel>(server, event.channel, true)};
             channel = channelPtr.get();
             channelModel.addChannel(channelPtr);
         }
     }
     if (channel) {
-        channel->addMessage(id, time, "<--", IrcUser::stripNick(nick) + " left the channel", MessageColor::Event);
-        channel->getUserModel().removeUser(IrcUser::stripNick(nick));
+        if (!irc_hideJoinPart(channel, IrcUser::stripNick(event.nick), event.time))
+            channel->addMessage(event.id, event.time, "<--", IrcUser::stripNick(event.nick) + " left the channel", MessageColor::Event);
+        channel->getUserModel().removeUser(IrcUser::stripNick(event.nick));
     }
 }
 
-void HarpoonClient::irc_handleNickChange(const QJsonObject& root) {
-    auto idValue = root.value("id");
-    auto timeValue = root.value("time");
-    auto nickValue = root.value("nick");
-    auto newNickValue = root.value("newNick");
-    auto serverIdValue = root.value("server");
-
-    if (!idValue.isString()) return;
-    if (!timeValue.isDouble()) return;
-    if (!nickValue.isString()) return;
-    if (!newNickValue.isString()) return;
-    if (!serverIdValue.isString()) return;
-
-    size_t id;
-    std::istringstream(idValue.toString().toStdString()) >> id;
-    double time = timeValue.toDouble();
-    QString nick = nickValue.toString();
-    QString newNick = newNickValue.toString();
-    QString serverId = serverIdValue.toString();
-
-    std::shared_ptr<IrcServer> server = serverTreeModel_.getServer(serverId);
+void HarpoonClient::irc_handleNickChange(const NickChangeEvent& event) {
+    std::shared_ptr<IrcServer> server = irc_getServer(event.serverId);
     if (server == nullptr) return;
 
-    if (server->getActiveNick() == nick)
-        server->setActiveNick(newNick);
+    if (server->getActiveNick() == event.nick)
+        server->setActiveNick(event.newNick);
 
+    QString nick = IrcUser::stripNick(event.nick);
     for (auto& channel : server->getChannelModel().getChannels()) {
-        if (channel->getUserModel().renameUser(IrcUser::stripNick(nick), newNick))
-            channel->getBacklogView()->addMessage(id, time, "<->", IrcUser::stripNick(nick) + " is now known as " + newNick, MessageColor::Event);
+        if (channel->getUserModel().renameUser(nick, event.newNick))
+            channel->addMessage(event.id, event.time, "<->", nick + " is now known as " + event.newNick, MessageColor::Event);
     }
 }
 
-void HarpoonClient::irc_handleNickModified(const QJsonObject& root) {
-    //auto timeValue = root.value("time");
-    auto serverIdValue = root.value("server");
-    auto oldNickValue = root.value("oldnick");
-    auto newNickValue = root.value("newnick");
-
-    //if (!timeValue.isDouble()) return;
-    if (!serverIdValue.isString()) return;
-    if (!oldNickValue.isString()) return;
-    if (!newNickValue.isString()) return;
-
-    //double time = timeValue.toDouble();
-    QString serverId = serverIdValue.toString();
-    QString oldNick = oldNickValue.toString();
-    QString newNick = newNickValue.toString();
-
-    std::shared_ptr<IrcServer> server = serverTreeModel_.getServer(serverId);
+void HarpoonClient::irc_handleNickModified(const NickModifiedEvent& event) {
+    std::shared_ptr<IrcServer> server = irc_getServer(event.serverId);
     if (server == nullptr) return;
 
-    if (server->getActiveNick() == oldNick)
-        server->setActiveNick(newNick);
+    if (server->getActiveNick() == event.oldNick)
+        server->setActiveNick(event.newNick);
 
-    server->getNickModel().modifyNick(oldNick, newNick);
+    server->getNickModel().modifyNick(event.oldNick, event.newNick);
 }
 
-void HarpoonClient::irc_handleKick(const QJsonObject& root) {
-    auto idValue = root.value("id");
-    auto timeValue = root.value("time");
-    auto nickValue = root.value("nick");
-    auto serverIdValue = root.value("server");
-    auto channelNameValue = root.value("channel");
-    auto targetValue = root.value("target");
-    auto reasonValue = root.value("msg");
-
-    if (!idValue.isString()) return;
-    if (!timeValue.isDouble()) return;
-    if (!nickValue.isString()) return;
-    if (!serverIdValue.isString()) return;
-    if (!channelNameValue.isString()) return;
-    if (!targetValue.isString()) return;
-    if (!reasonValue.isString()) return;
-
-    size_t id;
-    std::istringstream(idValue.toString().toStdString()) >> id;
-    double time = timeValue.toDouble();
-    QString nick = nickValue.toString();
-    QString serverId = serverIdValue.toString();
-    QString channelName = channelNameValue.toString();
-    QString target = targetValue.toString();
-    QString reason = reasonValue.toString();
-
-    auto server = serverTreeModel_.getServer(serverId);
-    IrcChannel* channel = server->getChannelModel().getChannel(channelName);
+void HarpoonClient::irc_handleKick(const KickEvent& event) {
+    auto server = irc_getServer(event.serverId);
+    if (!server) return;
+    IrcChannel* channel = server->getChannelModel().getChannel(event.channel);
     if (channel == nullptr) return;
-    channel->getUserModel().removeUser(IrcUser::stripNick(nick));
-    channel->addMessage(id, time, "<--", nick + " was kicked (Reason: " + reason + ")", MessageColor::Event);
+    channel->getUserModel().removeUser(IrcUser::stripNick(event.nick));
+    channel->addMessage(event.id, event.time, "<--", event.nick + " was kicked (Reason: " + event.reason + ")", MessageColor::Event);
 }
 
-void HarpoonClient::irc_handleQuit(const QJsonObject& root) {
-    auto idValue = root.value("id");
-    auto timeValue = root.value("time");
-    auto nickValue = root.value("nick");
-    auto serverIdValue = root.value("server");
-
-    if (!idValue.isString()) return;
-    if (!timeValue.isDouble()) return;
-    if (!nickValue.isString()) return;
-    if (!serverIdValue.isString()) return;
-
-    size_t id;
-    std::istringstream(idValue.toString().toStdString()) >> id;
-    double time = timeValue.toDouble();
-    QString nick = nickValue.toString();
-    QString serverId = serverIdValue.toString();
-
-    for (auto& server : serverTreeModel_.getServers()) {
-        for (auto& channel : server->getChannelModel().getChannels()) {
-            if (channel->getUserModel().removeUser(IrcUser::stripNick(nick)))
-                channel->getBacklogView()->addMessage(id, time, "<--", nick + " has quit", MessageColor::Event);
-        }
+void HarpoonClient::irc_handleQuit(const QuitEvent& event) {
+    QString nick = IrcUser::stripNick(event.nick);
+    std::shared_ptr<IrcServer> server = irc_getServer(event.serverId);
+    if (!server) return;
+    for (auto& channel : server->getChannelModel().getChannels()) {
+        if (channel->getUserModel().removeUser(nick) && !irc_hideJoinPart(channel.get(), nick, event.time))
+            channel->addMessage(event.id, event.time, "<--", event.nick + " has quit", MessageColor::Event);
     }
 }
 
-void HarpoonClient::irc_handleChat(const QJsonObject& root, bool notice) {
-    auto idValue = root.value("id");
-    auto timeValue = root.value("time");
-    auto nickValue = root.value("nick");
-    auto messageValue = root.value("msg");
-    auto serverIdValue = root.value("server");
-    auto channelNameValue = root.value("channel");
-
-    if (!idValue.isString()) return;
-    if (!timeValue.isDouble()) return;
-    if (!nickValue.isString()) return;
-    if (!messageValue.isString()) return;
-    if (!serverIdValue.isString()) return;
-    if (!channelNameValue.isString()) return;
-
-    size_t id;
-    std::istringstream(idValue.toString().toStdString()) >> id;
-    double time = timeValue.toDouble();
-    QString nick = nickValue.toString();
-    QString message = messageValue.toString();
-    QString serverId = serverIdValue.toString();
-    QString channelName = channelNameValue.toString();
-
-    std::shared_ptr<IrcServer> server = serverTreeModel_.getServer(serverId);
-    IrcChannel* channel = server->getChannelModel().getChannel(channelName);
+void HarpoonClient::irc_handleChat(const ChatEvent& event, bool notice) {
+    std::shared_ptr<IrcServer> server = irc_getServer(event.serverId);
+    if (!server) return;
+    IrcChannel* channel = server->getChannelModel().getChannel(event.channel);
     if (!channel) return;
-    channel->addMessage(id, time, '<'+IrcUser::stripNick(nick)+'>', message, notice ? MessageColor::Notice : MessageColor::Default);
+    channel->setSpoke(IrcUser::stripNick(event.nick), event.time);
+    channel->addMessage(event.id, event.time, '<'+IrcUser::stripNick(event.nick)+'>', event.message, notice ? MessageColor::Notice : MessageColor::Default);
 }
 
-void HarpoonClient::irc_handleAction(const QJsonObject& root) {
-    auto idValue = root.value("id");
-    auto timeValue = root.value("time");
-    auto nickValue = root.value("nick");
-    auto messageValue = root.value("msg");
-    auto serverIdValue = root.value("server");
-    auto channelNameValue = root.value("channel");
-
-    if (!idValue.isString()) return;
-    if (!timeValue.isDouble()) return;
-    if (!nickValue.isString()) return;
-    if (!messageValue.isString()) return;
-    if (!serverIdValue.isString()) return;
-    if (!channelNameValue.isString()) return;
-
-    size_t id;
-    std::istringstream(idValue.toString().toStdString()) >> id;
-    double time = timeValue.toDouble();
-    QString nick = nickValue.toString();
-    QString message = messageValue.toString();
-    QString serverId = serverIdValue.toString();
-    QString channelName = channelNameValue.toString();
-
-    std::shared_ptr<IrcServer> server = serverTreeModel_.getServer(serverId);
-    IrcChannel* channel = server->getChannelModel().getChannel(channelName);
+void HarpoonClient::irc_handleAction(const ChatEvent& event) {
+    std::shared_ptr<IrcServer> server = irc_getServer(event.serverId);
+    if (!server) return;
+    IrcChannel* channel = server->getChannelModel().getChannel(event.channel);
     if (!channel) return;
-    channel->addMessage(id, time, "*", IrcUser::stripNick(nick) + " " + message, MessageColor::Action);
-}
-
-void HarpoonClient::irc_handleMode(const QJsonObject& root) {
-    auto idValue = root.value("id");
-    auto timeValue = root.value("time");
-    auto serverIdValue = root.value("server");
-    auto channelNameValue = root.value("channel");
-    auto nickValue = root.value("nick");
-    auto modeValue = root.value("mode");
-    auto argsValue = root.value("args");
-
-    if (!idValue.isString()) return;
-    if (!timeValue.isDouble()) return;
-    if (!serverIdValue.isString()) return;
-    if (!channelNameValue.isString()) return;
-    if (!nickValue.isString()) return;
-    if (!modeValue.isString()) return;
-    if (!argsValue.isArray()) return;
+    channel->setSpoke(IrcUser::stripNick(event.nick), event.time);
+    channel->addMessage(event.id, event.time, "*", IrcUser::stripNick(event.nick) + " " + event.message, MessageColor::Action);
+}
 
-    size_t id;
-    std::istringstream(idValue.toString().toStdString()) >> id;
-    double time = timeValue.toDouble();
-    QString serverId = serverIdValue.toString();
-    QString channelName = channelNameValue.toString();
-    QString nick = nickValue.toString();
-    QString mode = modeValue.toString();
-    auto args = argsValue.toArray();
-
-    std::shared_ptr<IrcServer> server = serverTreeModel_.getServer(serverId);
-    IrcChannel* channel = server->getChannelModel().getChannel(channelName);
+void HarpoonClient::irc_handleMode(const ModeEvent& event) {
+    std::shared_ptr<IrcServer> server = irc_getServer(event.serverId);
+    if (!server) return;
+    IrcChannel* channel = server->getChannelModel().getChannel(event.channel);
     if (!channel) return;
 
     bool add = true;
-    size_t userIndex = 0;
-    for (QChar c : mode) {
+    int userIndex = 0;
+    for (QChar c : event.mode) {
         char modeChar = c.toLatin1();
         if (modeChar == '+') {
             add = true;
         } else if (modeChar == '-') {
             add = false;
         } else {
-            if (userIndex > args.count()) break;
-            auto nickTargetValue = args.at(userIndex);
-            QString nickTarget = nickTargetValue.toString();
+            if (userIndex >= event.args.count()) break;
+            const QString& nickTarget = event.args.at(userIndex);
 
             channel->getUserModel().changeMode(nickTarget, modeChar, add);
-            channel->addMessage(id,
-                                time,
+            channel->addMessage(event.id,
+                                event.time,
                                 "*",
-                                IrcUser::stripNick(nick) + " sets mode "
+                                IrcUser::stripNick(event.nick) + " sets mode "
                                   + (add ? '+' : '-') + QChar(modeChar)
                                   + " on " + nickTarget,
                                 MessageColor::Event);
@@ -888,130 +1139,395 @@ void HarpoonClient::irc_handleMode(const QJsonObject& root) {
     }
 }
 
-void HarpoonClient::irc_handleChatList(const QJsonObject& root) {
-    std::list<std::shared_ptr<IrcServer>> serverList;
+void HarpoonClient::irc_handleChatList(const ChatListEvent& event) {
+    // only apply what changed, so backlogs survive reconnects. the tree is
+    // shared with other cores, servers of those are left alone
+    QSet<QString> serverIds;
+    for (auto& serverEntry : event.servers) {
+        serverIds.insert(serverEntry.serverId);
+
+        std::shared_ptr<IrcServer> server = irc_getServer(serverEntry.serverId);
+        if (!server) {
+            serverTreeModel_.newServer(irc_createServer(serverEntry));
+            continue;
+        }
+
+        server->setActiveNick(serverEntry.nick);
+        if (server->getName() != serverEntry.name) {
+            server->setName(serverEntry.name);
+            serverTreeModel_.serverDataChanged(server.get());
+        }
+
+        IrcChannelTreeModel& channelModel = server->getChannelModel();
+        QSet<QString> channelNames;
+        for (auto& channelEntry : serverEntry.channels) {
+            channelNames.insert(channelEntry.name);
+
+            std::list<std::shared_ptr<IrcUser>> userList;
+            for (auto& user : channelEntry.users)
+                userList.push_back(std::make_shared<IrcUser>(user.nick, user.mode));
+
+            IrcChannel* channel = channelModel.getChannel(channelEntry.name);
+            if (!channel) {
+                auto newChannel = std::make_shared<IrcChannel>(server, channelEntry.name, channelEntry.disabled);
+                channelModel.addChannel(newChannel);
+                newChannel->resetUsers(userList);
+                continue;
+            }
+
+            channel->setDisabled(channelEntry.disabled);
+            channel->updateUsers(userList);
+        }
 
-    QJsonValue serversValue = root.value("servers");
-    if (!serversValue.isObject()) return;
+        for (auto& channel : channelModel.getChannels()) {
+            if (!channelNames.contains(channel->getName()))
+                channelModel.deleteChannel(channel->getName());
+        }
+    }
 
-    QJsonObject servers = serversValue.toObject();
-    for (auto sit = servers.begin(); sit != servers.end(); ++sit) {
-        QString serverId = sit.key();
-        QJsonValueRef serverValue = sit.value();
-        if (!serverValue.isObject()) return;
+    std::list<QString> removedServers;
+    for (auto& server : serverTreeModel_.getServers()) {
+        if (server->getCore() == core_ && !serverIds.contains(server->getId()))
+            removedServers.push_back(server->getId());
+    }
+    for (auto& serverId : removedServers)
+        serverTreeModel_.deleteServer(core_, serverId);
 
-        QJsonObject server = serverValue.toObject();
+    serverTreeModel_.setStale(core_, false);
+}
 
+size_t HarpoonClient::irc_getLastEventId() {
+    size_t lastId = std::numeric_limits<size_t>::max();
+    for (auto& server : serverTreeModel_.getServers()) {
+        if (server->getCore() != core_) continue;
+        for (auto& channel : server->getChannelModel().getChannels()) {
+            auto channelLastId = channel->getLastId();
+            if (channelLastId == std::numeric_limits<size_t>::max())
+                continue;
+            if (lastId == std::numeric_limits<size_t>::max() || channelLastId > lastId)
+                lastId = channelLastId;
+        }
+    }
+    return lastId;
+}
 
-        QJsonValue serverNameValue = server.value("name");
-        if (!serverNameValue.isString()) return;
-        QString serverName = serverNameValue.toString();
+void HarpoonClient::irc_requestMissedBacklog() {
+    // one request per channel for everything after the last seen id, sent
+    // back to back with the login
+    // with subscriptions the others are filled when they are opened
+    bool subscriptions = enabledCaps_.contains("subscribe");
+    for (auto& server : serverTreeModel_.getServers()) {
+        if (server->getCore() != core_) continue;
+        for (auto& channel : server->getChannelModel().getChannels()) {
+            if (subscriptions && !irc_isSubscribed(server->getId(), channel->getName()))
+                continue;
+            irc_requestBacklogAfter(server.get(), channel.get());
+        }
+    }
+}
 
-        QJsonValue activeNickValue = server.value("nick");
-        if (!activeNickValue.isString()) return;
-        QString activeNick = activeNickValue.toString();
+void HarpoonClient::irc_requestBacklogAfter(IrcServer* server, IrcChannel* channel) {
+    auto lastId = channel->getLastId();
+    if (lastId == std::numeric_limits<size_t>::max())
+        return; // nothing seen yet, loaded lazily on activation
+    irc_requestBacklogPage(server->getId(), channel->getName(), lastId);
+}
 
+void HarpoonClient::irc_requestBacklogPage(const QString& serverId, const QString& channel, size_t after) {
+    QJsonObject root;
+    root["cmd"] = "requestbacklog";
+    root["protocol"] = "irc";
+    root["server"] = serverId;
+    root["channel"] = channel;
+    root["after"] = std::to_string(after).c_str();
+    root["limit"] = static_cast<int>(gapPageSize);
+    gapRequests_.insert(qMakePair(serverId, channel), after);
+    sendCommand(root);
+}
 
-        QJsonValue channelsValue = server.value("channels");
-        if (!channelsValue.isObject()) return;
+bool HarpoonClient::irc_isSubscribed(const QString& serverId, const QString& channelName) const {
+    return std::find(recentChannels_.begin(), recentChannels_.end(), qMakePair(serverId, channelName)) != recentChannels_.end();
+}
 
-        auto currentServer = std::make_shared<IrcServer>(activeNick, serverId, serverName, false); // TODO: server needs to send if status is disabled
-        serverList.push_back(currentServer);
+QJsonObject HarpoonClient::irc_filterCommand(IrcServer* server, IrcChannel* channel) const {
+    // the bouncer drops filtered events, unless the nick spoke recently,
+    // and sends compact membership updates instead
+    QJsonArray suppress;
+    if (channel->getJoinPartFilter() > 0) {
+        suppress.append("join");
+        suppress.append("part");
+        suppress.append("quit");
+    }
 
-        QJsonObject channels = channelsValue.toObject();
-        for (auto cit = channels.begin(); cit != channels.end(); ++cit) {
-            QString channelName = cit.key();
-            QJsonValueRef channelValue = cit.value();
-            if (!channelValue.isObject()) return;
-            auto channelData = channelValue.toObject();
-            auto channelDisabledValue = channelData.value("disabled");
-            bool channelDisabled = channelDisabledValue.isBool() && channelDisabledValue.toBool();
+    QJsonObject root;
+    root["cmd"] = "setfilter";
+    root["protocol"] = "irc";
+    root["server"] = server->getId();
+    root["channel"] = channel->getName();
+    root["suppress"] = suppress;
+    root["unlessActive"] = channel->getJoinPartFilter() * 60;
+    return root;
+}
 
-            auto currentChannel = std::make_shared<IrcChannel>(currentServer, channelName, channelDisabled);
-            currentServer->getChannelModel().addChannel(currentChannel);
+QString HarpoonClient::irc_filterKey(const QString& serverId, const QString& channel) const {
+    return QString("joinPartFilter/%1/%2/%3").arg(core_).arg(serverId, channel);
+}
 
-            QJsonObject channel = channelValue.toObject();
-            QJsonValue usersValue = channel.value("users");
-            if (!usersValue.isObject()) return;
+bool HarpoonClient::irc_hideJoinPart(IrcChannel* channel, const QString& nick, double time) const {
+    // the bouncer filters itself, whatever still arrives is meant to be shown
+    return !enabledCaps_.contains("filter") && channel->hidesJoinPart(nick, time);
+}
 
-            std::list<std::shared_ptr<IrcUser>> userList;
-            QJsonObject users = usersValue.toObject();
-            for (auto uit = users.begin(); uit != users.end(); ++uit) {
-                QString nick = uit.key();
-                auto modeValue = uit.value();
-                if (!modeValue.isString()) continue;
-                auto mode = modeValue.toString();
-                userList.push_back(std::make_shared<IrcUser>(nick, mode));
-            }
+void HarpoonClient::irc_sendFilter(IrcServer* server, IrcChannel* channel) {
+    // the standby filters the same way, it may take over any time
+    QJsonObject root = irc_filterCommand(server, channel);
+    if (enabledCaps_.contains("filter"))
+        sendCommand(root);
+    if (standbyReady_ && standbyCaps_.contains("filter"))
+        QMetaObject::invokeMethod(standby_, "sendCommand", Qt::QueuedConnection, Q_ARG(QJsonObject, root));
+}
 
-            currentChannel->resetUsers(userList);
+void HarpoonClient::irc_sendFilters(HarpoonConnection* connection) {
+    for (auto& server : serverTreeModel_.getServers()) {
+        if (server->getCore() != core_) continue;
+        for (auto& channel : server->getChannelModel().getChannels()) {
+            if (channel->getJoinPartFilter() > 0)
+                QMetaObject::invokeMethod(connection, "sendCommand", Qt::QueuedConnection,
+                                          Q_ARG(QJsonObject, irc_filterCommand(server.get(), channel.get())));
         }
     }
-    serverTreeModel_.resetServers(serverList);
 }
 
-void HarpoonClient::irc_handleBacklogResponse(const QJsonObject& root) {
-    QJsonValue serverIdValue = root.value("server");
-    QJsonValue channelNameValue = root.value("channel");
-    QJsonValue linesValue = root.value("lines");
+void HarpoonClient::irc_handleMembers(const MembersEvent& event) {
+    std::shared_ptr<IrcServer> server = irc_getServer(event.serverId);
+    if (!server) return;
+    IrcChannel* channel = server->getChannelModel().getChannel(event.channel);
+    if (!channel) return;
+
+    for (auto& nick : event.parted)
+        channel->getUserModel().removeUser(nick);
+    for (auto& nick : event.joined) {
+        if (!channel->getUser(nick))
+            channel->getUserModel().addUser(std::make_shared<IrcUser>(nick));
+    }
+}
 
-    if (!serverIdValue.isString()
-        || !channelNameValue.isString()
-        || ! linesValue.isArray())
-        return;
+void HarpoonClient::irc_saveSubscriptions() {
+    settings_.beginWriteArray(QString("subscriptions/%1").arg(core_), recentChannels_.size());
+    int i = 0;
+    for (auto& entry : recentChannels_) {
+        settings_.setArrayIndex(i++);
+        settings_.setValue("server", entry.first);
+        settings_.setValue("channel", entry.second);
+    }
+    settings_.endArray();
+}
+
+QJsonObject HarpoonClient::irc_subscribeCommand() const {
+    QJsonArray channels;
+    for (auto& entry : recentChannels_) {
+        QJsonObject channel;
+        channel["server"] = entry.first;
+        channel["channel"] = entry.second;
+        channels.append(channel);
+    }
 
-    QString serverId = serverIdValue.toString();
-    QString channelName = channelNameValue.toString();
+    QJsonObject root;
+    root["cmd"] = "subscribe";
+    root["protocol"] = "irc";
+    root["channels"] = channels;
+    return root;
+}
 
-    std::shared_ptr<IrcServer> server = serverTreeModel_.getServer(serverId);
-    IrcChannel* channel = server->getChannelModel().getChannel(channelName);
+void HarpoonClient::activateChannel(IrcChannel* channel) {
+    auto server = channel->getServer().lock();
+    if (!server) return;
+    if (server->getCore() != core_) {
+        for (auto& core : cores_) {
+            if (core->getCore() == server->getCore())
+                core->activateChannel(channel);
+        }
+        return;
+    }
+    if (server->getChannelModel().getChannel(channel->getName()) != channel)
+        return; // the server's own backlog
+
+    channel->setUnread(0, 0);
+
+    // most recently viewed channels first, the tail drops out of the subscription
+    auto key = qMakePair(server->getId(), channel->getName());
+    bool subscribed = irc_isSubscribed(key.first, key.second);
+    recentChannels_.remove(key);
+    recentChannels_.push_front(key);
+    while (recentChannels_.size() > static_cast<size_t>(subscriptionSize_))
+        recentChannels_.pop_back();
+    irc_saveSubscriptions();
+
+    if (subscribed || !enabledCaps_.contains("subscribe")) return;
+    sendCommand(irc_subscribeCommand());
+    if (standbyReady_ && standbyCaps_.contains("subscribe"))
+        QMetaObject::invokeMethod(standby_, "sendCommand", Qt::QueuedConnection, Q_ARG(QJsonObject, irc_subscribeCommand()));
+
+    // only counters arrived while it wasn't subscribed, fetch what was missed
+    irc_requestBacklogAfter(server.get(), channel);
+}
+
+void HarpoonClient::irc_handleUnread(const UnreadEvent& event) {
+    std::shared_ptr<IrcServer> server = irc_getServer(event.serverId);
+    if (!server) return;
+    IrcChannel* channel = server->getChannelModel().getChannel(event.channel);
     if (!channel) return;
+    channel->setUnread(event.unread, event.highlights);
+}
+
+std::shared_ptr<IrcServer> HarpoonClient::irc_getServer(const QString& serverId) {
+    return serverTreeModel_.getServer(core_, serverId);
+}
+
+std::shared_ptr<IrcServer> HarpoonClient::irc_createServer(const IrcServerEntry& serverEntry) {
+    auto server = std::make_shared<IrcServer>(serverEntry.nick, serverEntry.serverId, serverEntry.name, false, core_); // TODO: server needs to send if status is disabled
+
+    for (auto& channelEntry : serverEntry.channels) {
+        auto channel = std::make_shared<IrcChannel>(server, channelEntry.name, channelEntry.disabled);
+        server->getChannelModel().addChannel(channel);
+
+        std::list<std::shared_ptr<IrcUser>> userList;
+        for (auto& user : channelEntry.users)
+            userList.push_back(std::make_shared<IrcUser>(user.nick, user.mode));
+
+        channel->resetUsers(userList);
+    }
+    return server;
+}
 
-    size_t smallestId = std::numeric_limits<size_t>::max();
+void HarpoonClient::irc_handleBacklogResponse(BacklogEvent&& event) {
+    std::shared_ptr<IrcServer> server = irc_getServer(event.serverId);
+    if (!server) return;
+    if (!server->getChannelModel().getChannel(event.channel)) return;
+
+    // a full page of a gap fill is followed by a request for the next one,
+    // older history loaded by scrolling up doesn't count
+    auto gapIt = gapRequests_.find(qMakePair(event.serverId, event.channel));
+    if (gapIt != gapRequests_.end() && !event.lines.empty()) {
+        size_t smallestId = std::numeric_limits<size_t>::max();
+        size_t largestId = 0;
+        for (auto& line : event.lines) {
+            smallestId = std::min(smallestId, line.id);
+            largestId = std::max(largestId, line.id);
+        }
+        if (smallestId > gapIt.value()) {
+            gapRequests_.erase(gapIt);
+            if (event.lines.size() >= gapPageSize)
+                irc_requestBacklogPage(event.serverId, event.channel, largestId);
+        }
+    }
 
-    QJsonArray lines = linesValue.toArray();
-    for (auto line : lines) {
-        if (!line.isObject()) return;
+    // applied in time slices so large responses don't block the ui
+    PendingBacklog pending;
+    pending.serverId = event.serverId;
+    pending.channel = event.channel;
+    pending.lines = std::move(event.lines);
+    pending.next = 0;
+    pending.smallestId = std::numeric_limits<size_t>::max();
+    pendingBacklog_.push_back(std::move(pending));
+
+    if (pendingBacklog_.size() == 1)
+        onBacklogTimer(); // the first slice is applied right away
+}
+
+void HarpoonClient::onBacklogTimer() {
+    QElapsedTimer sliceTimer;
+    sliceTimer.start();
+
+    while (!pendingBacklog_.empty()) {
+        PendingBacklog& pending = pendingBacklog_.front();
+        std::shared_ptr<IrcServer> server = irc_getServer(pending.serverId);
+        IrcChannel* channel = server ? server->getChannelModel().getChannel(pending.channel) : nullptr;
+        if (!channel) { // deleted while loading
+            pendingBacklog_.pop_front();
+            continue;
+        }
 
-        auto entry = line.toObject();
-        QJsonValue idValue = entry.value("id");
-        QJsonValue messageValue = entry.value("msg");
-        QJsonValue senderValue = entry.value("sender");
-        QJsonValue typeValue = entry.value("type");
-        QJsonValue timeValue = entry.value("time");
+        // one relayout per slice, the budget is checked between chunks
+        IrcBacklogView* backlogView = channel->getBacklogView();
+        backlogView->beginUpdate();
+        while (pending.next < pending.lines.size()) {
+            size_t end = std::min(pending.lines.size(), pending.next + backlogChunkSize);
+            std::vector<IrcChatLine> chunk;
+            chunk.reserve(end - pending.next);
+            for (; pending.next < end; ++pending.next) {
+                const BacklogLine& line = pending.lines[pending.next];
+                irc_addBacklogLine(chunk, line, channel, pending.spoke);
+                if (line.id < pending.smallestId)
+                    pending.smallestId = line.id;
+            }
+            channel->addMessages(std::move(chunk));
+            if (sliceTimer.elapsed() >= backlogSliceBudget)
+                break;
+        }
+        backlogView->endUpdate();
 
-        if (!idValue.isString()
-            || !messageValue.isString()
-            || !senderValue.isString()
-            || !typeValue.isString()
-            || !timeValue.isDouble())
+        if (pending.next < pending.lines.size()) {
+            backlogTimer_.start(0); // continue after pending input and paint events
+            return;
+        }
+        channel->onBacklogResponse(pending.smallestId);
+        pendingBacklog_.pop_front();
+        if (sliceTimer.elapsed() >= backlogSliceBudget) {
+            if (!pendingBacklog_.empty())
+                backlogTimer_.start(0);
             return;
+        }
+    }
+}
 
-        size_t id;
-        std::istringstream(idValue.toString().toStdString()) >> id;
-        QString message = messageValue.toString();
-        QString sender = senderValue.toString();
-        QString type = typeValue.toString();
-        double time = timeValue.toDouble();
-
-        if (type == "msg") {
-            channel->addMessage(id, time, '<'+IrcUser::stripNick(sender)+'>', message, MessageColor::Default);
-        } else if (type == "join") {
-            channel->addMessage(id, time, "-->", IrcUser::stripNick(sender) + " joined the channel", MessageColor::Event);
-        } else if (type == "part") {
-            channel->addMessage(id, time, "<--", IrcUser::stripNick(sender) + " left the channel", MessageColor::Event);
-        } else if (type == "quit") {
-            channel->addMessage(id, time, "<--", sender + " has quit", MessageColor::Event);
-        } else if (type == "kick") {
-            channel->addMessage(id, time, "<--", sender + " was kicked (Reason: " + message + ")", MessageColor::Event);
-        } else if (type == "notice") {
-            channel->addMessage(id, time, '<'+IrcUser::stripNick(sender)+'>', message, MessageColor::Notice);
-        } else if (type == "action") {
-            channel->addMessage(id, time, "*", IrcUser::stripNick(sender) + " " + message, MessageColor::Action);
+void HarpoonClient::irc_addBacklogLine(std::vector<IrcChatLine>& lines, const BacklogLine& line, IrcChannel* channel, QHash<QString, double>& spoke) {
+    // the join/part filter applies to history as well; lines come oldest
+    // first, so a speaker is known before their part or quit
+    QString nick = IrcUser::stripNick(line.sender);
+    switch (line.type) {
+    case BacklogLineType::Message:
+    case BacklogLineType::Notice:
+    case BacklogLineType::Action:
+        spoke[nick] = line.time;
+        channel->setSpoke(nick, line.time);
+        break;
+    case BacklogLineType::Join:
+    case BacklogLineType::Part:
+    case BacklogLineType::Quit:
+        if (channel->hidesJoinPart(nick, line.time)) {
+            auto it = spoke.find(nick);
+            if (it == spoke.end() || line.time - it.value() > channel->getJoinPartFilter() * 60000.0)
+                return;
         }
+        break;
+    default:
+        break;
+    }
 
-        if (id < smallestId)
-            smallestId = id;
+    switch (line.type) {
+    case BacklogLineType::Message:
+        lines.emplace_back(line.id, line.time, '<'+IrcUser::stripNick(line.sender)+'>', line.message, MessageColor::Default);
+        break;
+    case BacklogLineType::Join:
+        lines.emplace_back(line.id, line.time, "-->", IrcUser::stripNick(line.sender) + " joined the channel", MessageColor::Event);
+        break;
+    case BacklogLineType::Part:
+        lines.emplace_back(line.id, line.time, "<--", IrcUser::stripNick(line.sender) + " left the channel", MessageColor::Event);
+        break;
+    case BacklogLineType::Quit:
+        lines.emplace_back(line.id, line.time, "<--", line.sender + " has quit", MessageColor::Event);
+        break;
+    case BacklogLineType::Kick:
+        lines.emplace_back(line.id, line.time, "<--", line.sender + " was kicked (Reason: " + line.message + ")", MessageColor::Event);
+        break;
+    case BacklogLineType::Notice:
+        lines.emplace_back(line.id, line.time, '<'+IrcUser::stripNick(line.sender)+'>', line.message, MessageColor::Notice);
+        break;
+    case BacklogLineType::Action:
+        lines.emplace_back(line.id, line.time, "*", IrcUser::stripNick(line.sender) + " " + line.message, MessageColor::Action);
+        break;
+    case BacklogLineType::Unknown:
+        break;
     }
-    channel->onBacklogResponse(smallestId);
 }
@@ -1,45 +1,107 @@
 #ifndef HARPOONCLIENT_H
 #define HARPOONCLIENT_H
 
-#include <QWebSocket>
+#include <QThread>
 #include <QString>
+#include <QStringList>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QSettings>
 #include <QUrl>
 #include <QHash>
+#include <QPair>
+#include <QJsonObject>
+#include <QList>
 #include <list>
 #include <memory>
+#include <random>
+#include <deque>
+#include <vector>
 
+#include "HarpoonEvent.hpp"
 
-class QJsonObject;
-class QJsonDocument;
+
+class HarpoonConnection;
 class IrcServer;
 class IrcServerTreeModel;
 class SettingsTypeModel;
 class IrcHost;
 class IrcChannel;
+class IrcChatLine;
 class IrcUser;
 
 
+enum class ConnectionState {
+    Disconnected,
+    Connecting,     // websocket handshake
+    Authenticating, // login sent
+    Syncing,        // logged in, waiting for the chat list
+    Live,
+    BackingOff,     // waiting for the next reconnect attempt
+};
+
+
 class HarpoonClient : public QObject {
     Q_OBJECT
 
+    // a backlog response that is still being applied
+    struct PendingBacklog {
+        QString serverId;
+        QString channel;
+        std::vector<BacklogLine> lines;
+        size_t next;
+        size_t smallestId;
+        QHash<QString, double> spoke; // nick -> latest message so far, for the join/part filter
+    };
+
     bool shutdown_;
+    int core_; // tags the servers of this bouncer core in the shared tree
+    std::list<std::unique_ptr<HarpoonClient>> cores_; // further cores, owned by core 0
 
     IrcServerTreeModel& serverTreeModel_;
     SettingsTypeModel& settingsTypeModel_;
 
-    QUrl harpoonUrl_;
+    QList<QUrl> harpoonUrls_; // bouncer endpoints in order of preference
+    int activeEndpoint_;
+    int standbyEndpoint_;
     QString username_;
     QString password_;
 
-    QWebSocket ws_;
+    QThread networkThread_;
+    HarpoonConnection* connection_;
+    HarpoonConnection* standby_; // logged in to another endpoint, takes over on failure
+    bool standbyReady_;
+    int standbyAttempts_;
+    QString standbyResumeToken_;
+    QStringList standbyCaps_;
+    std::deque<std::unique_ptr<HarpoonEvent>> standbyEvents_; // everything since its login, replayed on failover
+    QTimer standbyReconnectTimer_;
+    size_t lastEventId_; // events up to this id were applied
 
     QString activeNick_;
+    QStringList enabledCaps_;
+    QString resumeToken_;
+    bool resuming_; // a RESUME was sent instead of LOGIN
+    bool replaying_; // standby events are applied, ids are not deduplicated
+    ConnectionState connectionState_;
+    int reconnectAttempts_;
+    std::mt19937 reconnectRandom_;
     QTimer reconnectTimer_;
-    QTimer pingTimer_;
+    QElapsedTimer downtime_; // started when the connection is lost
+    std::list<QPair<QString, QString>> recentChannels_; // server id, channel; most recent first
+    QHash<QPair<QString, QString>, size_t> gapRequests_; // server id, channel -> after id of the page in flight
+    int subscriptionSize_; // channels that get full events
+    std::deque<PendingBacklog> pendingBacklog_;
+    QTimer backlogTimer_;
     QSettings settings_;
 
+    HarpoonClient(IrcServerTreeModel& serverTreeModel,
+                  SettingsTypeModel& settingsTypeModel,
+                  int core,
+                  const QString& username,
+                  const QString& password,
+                  const QString& hosts);
+
 public:
     HarpoonClient(IrcServerTreeModel& serverTreeModel,
                   SettingsTypeModel& settingsTypeModel);
@@ -49,43 +111,78 @@ public:
                    const QString& password,
                    const QString& host);
     QSettings& getSettings();
+    ConnectionState getConnectionState() const;
+    int getCore() const;
 
 private:
-    void onConnected();
+    void onConnected(const ConnectedEvent& event);
     void onDisconnected();
-    void onTextMessage(const QString& message);
-    void onBinaryMessage(const QByteArray& data);
-    void handleCommand(const QJsonDocument& doc);
-    void handleLogin(const QJsonObject& root);
-
-    void irc_handleSettings(const QJsonObject& root);
-    void irc_handleChatList(const QJsonObject& root);
-    void irc_handleUserList(const QJsonObject& root);
-    void irc_handleTopic(const QJsonObject& root);
-    void irc_handleChat(const QJsonObject& root, bool notice);
-    void irc_handleAction(const QJsonObject& root);
-    void irc_handleMode(const QJsonObject& root);
-    void irc_handleJoin(const QJsonObject& root);
-    void irc_handlePart(const QJsonObject& root);
-    void irc_handleNickChange(const QJsonObject& root);
-    void irc_handleNickModified(const QJsonObject& root);
-    void irc_handleQuit(const QJsonObject& root);
-    void irc_handleKick(const QJsonObject& root);
-    void irc_handleServerAdded(const QJsonObject& root);
-    void irc_handleServerDeleted(const QJsonObject& root);
-    void irc_handleHostAdded(const QJsonObject& root);
-    void irc_handleHostDeleted(const QJsonObject& root);
-    void irc_handleBacklogResponse(const QJsonObject& root);
+    void setConnectionState(ConnectionState state);
+    int backoffDelay(int& attempts);
+    void scheduleReconnect();
+    void scheduleStandbyReconnect();
+    void handleStandbyEvent(std::unique_ptr<HarpoonEvent>&& event);
+    void handleStandbyLogin(const LoginEvent& event);
+    void promoteStandby();
+    void sendText(const QString& message);
+    void sendLogin();
+    void sendQuerySettings();
+    void sendCommand(const QJsonObject& root);
+    void handleEvent(HarpoonEvent& event);
+    void handleLogin(const LoginEvent& event);
+    void handleBatch(const BatchEvent& event);
+
+    void irc_handleSettings(const SettingsEvent& event);
+    void irc_handleChatList(const ChatListEvent& event);
+    std::shared_ptr<IrcServer> irc_getServer(const QString& serverId);
+    std::shared_ptr<IrcServer> irc_createServer(const IrcServerEntry& serverEntry);
+    size_t irc_getLastEventId();
+    void irc_requestMissedBacklog();
+    void irc_requestBacklogAfter(IrcServer* server, IrcChannel* channel);
+    void irc_requestBacklogPage(const QString& serverId, const QString& channel, size_t after);
+    bool irc_isSubscribed(const QString& serverId, const QString& channelName) const;
+    QJsonObject irc_subscribeCommand() const;
+    void irc_saveSubscriptions();
+    QJsonObject irc_filterCommand(IrcServer* server, IrcChannel* channel) const;
+    QString irc_filterKey(const QString& serverId, const QString& channel) const;
+    bool irc_hideJoinPart(IrcChannel* channel, const QString& nick, double time) const;
+    void irc_sendFilter(IrcServer* server, IrcChannel* channel);
+    void irc_sendFilters(HarpoonConnection* connection);
+    void irc_handleMembers(const MembersEvent& event);
+    void irc_handleUnread(const UnreadEvent& event);
+    void irc_handleUserList(const UserListEvent& event);
+    void irc_handleTopic(const TopicEvent& event);
+    void irc_handleChat(const ChatEvent& event, bool notice);
+    void irc_handleAction(const ChatEvent& event);
+    void irc_handleMode(const ModeEvent& event);
+    void irc_handleJoin(const JoinEvent& event);
+    void irc_handlePart(const PartEvent& event);
+    void irc_handleNickChange(const NickChangeEvent& event);
+    void irc_handleNickModified(const NickModifiedEvent& event);
+    void irc_handleQuit(const QuitEvent& event);
+    void irc_handleKick(const KickEvent& event);
+    void irc_handleServerAdded(const ServerAddedEvent& event);
+    void irc_handleServerDeleted(const ServerDeletedEvent& event);
+    void irc_handleHostAdded(const HostAddedEvent& event);
+    void irc_handleHostDeleted(const HostDeletedEvent& event);
+    void irc_handleBacklogResponse(BacklogEvent&& event);
+    void irc_addBacklogLine(std::vector<IrcChatLine>& lines, const BacklogLine& line, IrcChannel* channel, QHash<QString, double>& spoke);
 
 public Q_SLOTS:
+    void onEventsAvailable(HarpoonConnection* connection);
     void onReconnectTimer();
-    void onPingTimer();
+    void onStandbyReconnectTimer();
+    void onBacklogTimer();
     void onNewChannel(std::shared_ptr<IrcChannel> channel);
     void sendMessage(IrcServer* server, IrcChannel* channel, const QString& message);
+    void activateChannel(IrcChannel* channel);
     void backlogRequest(IrcChannel* channel);
 
 signals:
     void topicChanged(IrcChannel* channel, const QString& topic);
+    // core 0 forwards the signals of the further cores
+    void latencyChanged(int core, int rtt); // milliseconds, -1 while disconnected
+    void connectionStateChanged(int core, ConnectionState state);
 };
 
 #endif
@@ -0,0 +1,224 @@
+#include "HarpoonConnection.hpp"
+#include "moc_HarpoonConnection.cpp"
+
+#include <QThread>
+#include <QDebug>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QCborValue>
+#include <QCborMap>
+#include <QHostInfo>
+#include <QLoggingCategory>
+
+
+// raw frames, enable with QT_LOGGING_RULES="harpoon.frames.debug=true"
+Q_LOGGING_CATEGORY(frameLog, "harpoon.frames", QtWarningMsg)
+
+
+HarpoonConnection::HarpoonConnection()
+    : ws_(QString(), QWebSocketProtocol::VersionLatest, this)
+    , events_{4096}
+    , notifyPending_{false}
+    , waitingForSpace_{false}
+    , cbor_{false}
+    , pingTimer_(this)
+    , pongTimer_(this)
+    , pingInterval_{30000}
+    , pongTimeout_{10000}
+    , rtt_{-1}
+{
+    pongTimer_.setSingleShot(true);
+    connect(&ws_, &QWebSocket::connected, this, &HarpoonConnection::onConnected);
+    connect(&ws_, &QWebSocket::disconnected, this, &HarpoonConnection::onDisconnected);
+    connect(&ws_, &QWebSocket::textMessageReceived, this, &HarpoonConnection::onTextMessage);
+    connect(&ws_, &QWebSocket::binaryMessageReceived, this, &HarpoonConnection::onBinaryMessage);
+    connect(&ws_, &QWebSocket::pong, this, &HarpoonConnection::onPong);
+    connect(&ws_, static_cast<void (QWebSocket::*)(QAbstractSocket::SocketError)>(&QWebSocket::error), this, &HarpoonConnection::onError);
+    connect(&pingTimer_, &QTimer::timeout, this, &HarpoonConnection::onPingTimer);
+    connect(&pongTimer_, &QTimer::timeout, this, &HarpoonConnection::onPongTimeout);
+}
+
+void HarpoonConnection::open(const QUrl& url) {
+    // every wss open is a full tls handshake: QWebSocket creates a new socket
+    // per open and doesn't expose it, so no session ticket can be carried over
+    openTimer_.start();
+    ws_.open(url);
+}
+
+void HarpoonConnection::prewarm(const QUrl& url) {
+    // fills qt's host cache, the next open skips the dns round trip
+    QString host = url.host();
+    QElapsedTimer lookupTimer;
+    lookupTimer.start();
+    QHostInfo::lookupHost(host, this, [host, lookupTimer](const QHostInfo& info) {
+            qDebug() << "prewarmed" << host << "in" << lookupTimer.elapsed() << "ms" << info.addresses();
+        });
+}
+
+void HarpoonConnection::close() {
+    ws_.close();
+}
+
+void HarpoonConnection::shutdown() {
+    // the client is going away, no reconnect follows
+    pingTimer_.stop();
+    pongTimer_.stop();
+    ws_.abort();
+}
+
+void HarpoonConnection::sendTextMessage(const QString& message) {
+    ws_.sendTextMessage(message);
+}
+
+void HarpoonConnection::sendCommand(const QJsonObject& root) {
+    if (cbor_) {
+        ws_.sendBinaryMessage(QCborMap::fromJsonObject(root).toCborValue().toCbor());
+    } else {
+        ws_.sendTextMessage(QJsonDocument{root}.toJson(QJsonDocument::JsonFormat::Compact));
+    }
+}
+
+void HarpoonConnection::enableCapabilities(const QStringList& caps) {
+    QJsonObject root;
+    root["cmd"] = "enablecaps";
+    root["caps"] = QJsonArray::fromStringList(caps);
+    sendCommand(root);
+
+    // the bouncer switches its encoding after reading this command
+    if (caps.contains("cbor"))
+        cbor_ = true;
+}
+
+void HarpoonConnection::setKeepAlive(int pingInterval, int pongTimeout) {
+    pingInterval_ = pingInterval;
+    pongTimeout_ = pongTimeout;
+    if (pingTimer_.isActive())
+        pingTimer_.start(pingInterval_);
+}
+
+bool HarpoonConnection::takeEvent(std::unique_ptr<HarpoonEvent>& event) {
+    if (!events_.pop(event))
+        return false;
+    if (waitingForSpace_.load()) {
+        QMutexLocker locker(&spaceMutex_);
+        spaceAvailable_.wakeOne();
+    }
+    return true;
+}
+
+void HarpoonConnection::acknowledgeEvents() {
+    notifyPending_.store(false);
+}
+
+void HarpoonConnection::pushEvent(std::unique_ptr<HarpoonEvent>&& event) {
+    if (!events_.push(std::move(event))) {
+        // the gui thread is behind: sleep until it took an event, meanwhile
+        // the socket isn't read and tcp pushes back on the bouncer. the
+        // timeout rechecks for shutdown
+        QMutexLocker locker(&spaceMutex_);
+        waitingForSpace_.store(true);
+        while (!events_.push(std::move(event))) {
+            if (QThread::currentThread()->isInterruptionRequested()) {
+                waitingForSpace_.store(false);
+                return;
+            }
+            spaceAvailable_.wait(&spaceMutex_, 100);
+        }
+        waitingForSpace_.store(false);
+        // the stall was ours, not the peer's
+        if (pongTimer_.isActive())
+            pongTimer_.start(pongTimeout_);
+    }
+    // only one wakeup is queued until the gui thread acknowledges it
+    if (!notifyPending_.exchange(true))
+        emit eventsAvailable();
+}
+
+void HarpoonConnection::onConnected() {
+    cbor_ = false; // every session starts out as json
+    decoder_.reset();
+    rtt_ = -1;
+    pingTimer_.start(pingInterval_);
+
+    std::unique_ptr<ConnectedEvent> event{new ConnectedEvent};
+    event->handshakeTime = static_cast<int>(openTimer_.elapsed());
+    pushEvent(std::move(event));
+}
+
+void HarpoonConnection::onDisconnected() {
+    pingTimer_.stop();
+    pongTimer_.stop();
+    pushEvent(std::unique_ptr<HarpoonEvent>{new HarpoonEvent{HarpoonEventType::Disconnected}});
+}
+
+void HarpoonConnection::onError(QAbstractSocket::SocketError error) {
+    qWarning() << "websocket error" << error << ws_.errorString();
+    // a failed connect never emits disconnected, report it anyway
+    pushEvent(std::unique_ptr<HarpoonEvent>{new HarpoonEvent{HarpoonEventType::Disconnected}});
+}
+
+void HarpoonConnection::onTextMessage(const QString& message) {
+    qCDebug(frameLog) << message;
+    if (pongTimer_.isActive()) // any frame proves the peer is alive
+        pongTimer_.start(pongTimeout_);
+    auto event = decodeJson(message.toUtf8());
+    if (event)
+        pushEvent(std::move(event));
+}
+
+void HarpoonConnection::onBinaryMessage(const QByteArray& data) {
+    qCDebug(frameLog) << data;
+    if (pongTimer_.isActive())
+        pongTimer_.start(pongTimeout_);
+    if (data.isEmpty()) return;
+
+    std::unique_ptr<HarpoonEvent> event;
+    if (data.at(0) == '{') { // a json object, cbor maps never start with this byte
+        event = decodeJson(data); // parsed from the raw bytes, no utf-16 round trip
+    } else {
+        QCborValue value = QCborValue::fromCbor(data);
+        if (!value.isMap()) return;
+        event = decoder_.decode(value.toMap());
+    }
+    if (event)
+        pushEvent(std::move(event));
+}
+
+std::unique_ptr<HarpoonEvent> HarpoonConnection::decodeJson(const QByteArray& data) {
+#ifdef HARPOON_SIMDJSON
+    SimdJsonObject root;
+    if (!SimdJsonObject::parse(jsonParser_, data, root)) return nullptr;
+    return decoder_.decode(root);
+#else
+    QJsonDocument doc = QJsonDocument::fromJson(data);
+    if (!doc.isObject()) return nullptr;
+    return decoder_.decode(doc.object());
+#endif
+}
+
+void HarpoonConnection::onPingTimer() {
+    ws_.ping();
+    // the deadline runs from the oldest unanswered ping
+    if (!pongTimer_.isActive())
+        pongTimer_.start(pongTimeout_);
+}
+
+void HarpoonConnection::onPong(quint64 elapsedTime, const QByteArray&) {
+    pongTimer_.stop();
+
+    // exponentially weighted like tcp's srtt
+    if (rtt_ < 0)
+        rtt_ = elapsedTime;
+    else
+        rtt_ += (static_cast<double>(elapsedTime) - rtt_) / 8;
+
+    std::unique_ptr<LatencyEvent> event{new LatencyEvent};
+    event->rtt = static_cast<int>(rtt_ + 0.5);
+    pushEvent(std::move(event));
+}
+
+void HarpoonConnection::onPongTimeout() {
+    qWarning() << "no pong within" << pongTimeout_ << "ms, dropping connection";
+    ws_.abort(); // emits disconnected, which schedules the reconnect
+}
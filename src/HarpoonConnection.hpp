@@ -0,0 +1,80 @@
+#ifndef HARPOONCONNECTION_H
+#define HARPOONCONNECTION_H
+
+#include <QObject>
+#include <QWebSocket>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QString>
+#include <QByteArray>
+#include <QUrl>
+#include <QJsonObject>
+#include <QStringList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <memory>
+
+#include "HarpoonEvent.hpp"
+#include "HarpoonDecoder.hpp"
+#include "SpscQueue.hpp"
+
+
+// Owns the websocket and lives on the network thread. Incoming frames are
+// decoded here and handed to the GUI thread through a lock-free queue.
+class HarpoonConnection : public QObject {
+    Q_OBJECT
+
+    QWebSocket ws_;
+    HarpoonDecoder decoder_;
+    SpscQueue<std::unique_ptr<HarpoonEvent>> events_;
+    std::atomic<bool> notifyPending_;
+    std::atomic<bool> waitingForSpace_; // the queue is full, pushEvent waits
+    QMutex spaceMutex_;
+    QWaitCondition spaceAvailable_; // woken by takeEvent
+    bool cbor_; // commands are sent as binary cbor frames
+    QTimer pingTimer_;
+    QTimer pongTimer_; // the peer is considered dead when this fires
+    int pingInterval_;
+    int pongTimeout_;
+    double rtt_; // negative until the first pong
+    QElapsedTimer openTimer_;
+#ifdef HARPOON_SIMDJSON
+    simdjson::dom::parser jsonParser_; // keeps its buffers across frames
+#endif
+
+    std::unique_ptr<HarpoonEvent> decodeJson(const QByteArray& data);
+
+    void pushEvent(std::unique_ptr<HarpoonEvent>&& event);
+    void onConnected();
+    void onDisconnected();
+    void onTextMessage(const QString& message);
+    void onBinaryMessage(const QByteArray& data);
+    void onError(QAbstractSocket::SocketError error);
+    void onPingTimer();
+    void onPong(quint64 elapsedTime, const QByteArray&);
+    void onPongTimeout();
+
+public:
+    HarpoonConnection();
+
+    // called from the GUI thread only
+    bool takeEvent(std::unique_ptr<HarpoonEvent>& event);
+    void acknowledgeEvents();
+
+public Q_SLOTS:
+    void open(const QUrl& url);
+    void close();
+    void shutdown();
+    void sendTextMessage(const QString& message);
+    void sendCommand(const QJsonObject& root);
+    void enableCapabilities(const QStringList& caps);
+    void setKeepAlive(int pingInterval, int pongTimeout);
+    void prewarm(const QUrl& url);
+
+signals:
+    void eventsAvailable();
+};
+
+
+#endif
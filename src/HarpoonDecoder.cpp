@@ -0,0 +1,862 @@
+#include "HarpoonDecoder.hpp"
+
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonValue>
+#include <QCborMap>
+#include <QCborArray>
+#include <QCborValue>
+#include <QLatin1String>
+#include <QDebug>
+
+
+static const size_t maxSymbols = 65536;
+
+
+// The decoder works on any frame representation that provides these
+// accessors, currently QJsonObject (text frames) and QCborMap (binary frames).
+template <typename Object> struct FrameTraits;
+
+template <> struct FrameTraits<QJsonObject> {
+    using Value = QJsonValue;
+    using Array = QJsonArray;
+};
+
+template <> struct FrameTraits<QCborMap> {
+    using Value = QCborValue;
+    using Array = QCborArray;
+};
+
+#ifdef HARPOON_SIMDJSON
+template <> struct FrameTraits<SimdJsonObject> {
+    using Value = SimdJsonValue;
+    using Array = SimdJsonArray;
+};
+
+static bool isString(const SimdJsonValue& value) { return value.isString(); }
+static QString toString(const SimdJsonValue& value) { return value.toString(); }
+static bool isNumber(const SimdJsonValue& value) { return value.isNumber(); }
+static double toDouble(const SimdJsonValue& value) { return value.toDouble(); }
+static int toInt(const SimdJsonValue& value) { return static_cast<int>(value.toInteger()); }
+static bool isBool(const SimdJsonValue& value) { return value.isBool(); }
+static bool toBool(const SimdJsonValue& value) { return value.toBool(); }
+static bool isObject(const SimdJsonValue& value) { return value.isObject(); }
+static SimdJsonObject toObject(const SimdJsonValue& value) { return value.toObject(); }
+static bool isArray(const SimdJsonValue& value) { return value.isArray(); }
+static SimdJsonArray toArray(const SimdJsonValue& value) { return value.toArray(); }
+static qint64 toInteger(const SimdJsonValue& value) { return value.toInteger(); }
+static bool isBlob(const SimdJsonValue& value) { return value.isString(); }
+static QByteArray toBlob(const SimdJsonValue& value) { return value.toUtf8(); }
+static QString keyOf(const SimdJsonObject::ConstIterator& it) { return it.key(); }
+
+static bool toId(const SimdJsonValue& value, size_t& out) {
+    if (!value.isString()) return false;
+    return HarpoonDecoder::parseId(value.toString(), out);
+}
+#endif
+
+static bool isString(const QJsonValue& value) { return value.isString(); }
+static bool isString(const QCborValue& value) { return value.isString(); }
+static QString toString(const QJsonValue& value) { return value.toString(); }
+static QString toString(const QCborValue& value) { return value.toString(); }
+static bool isNumber(const QJsonValue& value) { return value.isDouble(); }
+static bool isNumber(const QCborValue& value) { return value.isDouble() || value.isInteger(); }
+static double toDouble(const QJsonValue& value) { return value.toDouble(); }
+static double toDouble(const QCborValue& value) { return value.toDouble(); }
+static int toInt(const QJsonValue& value) { return value.toInt(); }
+static int toInt(const QCborValue& value) { return static_cast<int>(value.toInteger()); }
+static bool isBool(const QJsonValue& value) { return value.isBool(); }
+static bool isBool(const QCborValue& value) { return value.isBool(); }
+static bool toBool(const QJsonValue& value) { return value.toBool(); }
+static bool toBool(const QCborValue& value) { return value.toBool(); }
+static bool isObject(const QJsonValue& value) { return value.isObject(); }
+static bool isObject(const QCborValue& value) { return value.isMap(); }
+static QJsonObject toObject(const QJsonValue& value) { return value.toObject(); }
+static QCborMap toObject(const QCborValue& value) { return value.toMap(); }
+static bool isArray(const QJsonValue& value) { return value.isArray(); }
+static bool isArray(const QCborValue& value) { return value.isArray(); }
+static QJsonArray toArray(const QJsonValue& value) { return value.toArray(); }
+static QCborArray toArray(const QCborValue& value) { return value.toArray(); }
+static qint64 toInteger(const QJsonValue& value) { return static_cast<qint64>(value.toDouble()); }
+static qint64 toInteger(const QCborValue& value) { return value.isInteger() ? value.toInteger() : static_cast<qint64>(value.toDouble()); }
+// utf-8 text, cbor sends a byte string, json a plain string
+static bool isBlob(const QJsonValue& value) { return value.isString(); }
+static bool isBlob(const QCborValue& value) { return value.isByteArray() || value.isString(); }
+static QByteArray toBlob(const QJsonValue& value) { return value.toString().toUtf8(); }
+static QByteArray toBlob(const QCborValue& value) { return value.isByteArray() ? value.toByteArray() : value.toString().toUtf8(); }
+static QString keyOf(const QJsonObject::const_iterator& it) { return it.key(); }
+static QString keyOf(const QCborMap::ConstIterator& it) { return it.key().toString(); }
+
+// ids are decimal strings in json, binary frames may carry plain integers
+static bool toId(const QJsonValue& value, size_t& out) {
+    if (!value.isString()) return false;
+    return HarpoonDecoder::parseId(value.toString(), out);
+}
+
+static bool toId(const QCborValue& value, size_t& out) {
+    if (value.isInteger()) {
+        out = static_cast<size_t>(value.toInteger());
+        return true;
+    }
+    if (!value.isString()) return false;
+    return HarpoonDecoder::parseId(value.toString(), out);
+}
+
+template <typename Object>
+static bool readString(const Object& root, QLatin1String key, QString& out) {
+    typename FrameTraits<Object>::Value value = root.value(key);
+    if (!isString(value)) return false;
+    out = toString(value);
+    return true;
+}
+
+template <typename Object>
+static bool readId(const Object& root, QLatin1String key, size_t& out) {
+    return toId(root.value(key), out);
+}
+
+template <typename Object>
+static bool readDouble(const Object& root, QLatin1String key, double& out) {
+    typename FrameTraits<Object>::Value value = root.value(key);
+    if (!isNumber(value)) return false;
+    out = toDouble(value);
+    return true;
+}
+
+template <typename Object>
+static bool readInt(const Object& root, QLatin1String key, int& out) {
+    typename FrameTraits<Object>::Value value = root.value(key);
+    if (!isNumber(value)) return false;
+    out = toInt(value);
+    return true;
+}
+
+template <typename Object>
+static bool readBool(const Object& root, QLatin1String key, bool& out) {
+    typename FrameTraits<Object>::Value value = root.value(key);
+    if (!isBool(value)) return false;
+    out = toBool(value);
+    return true;
+}
+
+template <typename Object>
+static bool readStringList(const Object& root, QLatin1String key, QStringList& out) {
+    typename FrameTraits<Object>::Value listValue = root.value(key);
+    if (!isArray(listValue)) return false;
+    const typename FrameTraits<Object>::Array list = toArray(listValue);
+    for (typename FrameTraits<Object>::Value entry : list) {
+        if (isString(entry))
+            out.push_back(toString(entry));
+    }
+    return true;
+}
+
+template <typename Object>
+static bool readUsers(const Object& root, QLatin1String key, std::vector<IrcUserEntry>& out) {
+    typename FrameTraits<Object>::Value usersValue = root.value(key);
+    if (!isObject(usersValue)) return false;
+    Object users = toObject(usersValue);
+    out.reserve(users.size());
+    for (auto it = users.constBegin(); it != users.constEnd(); ++it) {
+        typename FrameTraits<Object>::Value modeValue = it.value();
+        if (!isString(modeValue)) continue;
+        out.push_back(IrcUserEntry{keyOf(it), toString(modeValue)});
+    }
+    return true;
+}
+
+bool HarpoonDecoder::parseId(const QString& text, size_t& id) {
+    if (text.isEmpty()) return false;
+    size_t value = 0;
+    for (QChar c : text) {
+        ushort digit = c.unicode() - '0';
+        if (digit > 9) return false;
+        value = value * 10 + digit;
+    }
+    id = value;
+    return true;
+}
+
+HarpoonDecoder::HarpoonDecoder()
+{
+}
+
+// Command names are unique over all protocols, so a frame is looked up by
+// "cmd" alone and its protocol is checked afterwards. commandTable() follows
+// this order.
+struct CommandName {
+    const char* protocol; // empty for the core protocol
+    const char* cmd;
+};
+static const CommandName commandNames[] = {
+    {"", "login"},
+    {"", "batch"},
+    {"irc", "chatlist"},
+    {"irc", "chat"},
+    {"irc", "userlist"},
+    {"irc", "nickchange"},
+    {"irc", "nickmodified"},
+    {"irc", "serveradded"},
+    {"irc", "serverremoved"},
+    {"irc", "hostadded"},
+    {"irc", "hostdeleted"},
+    {"irc", "topic"},
+    {"irc", "action"},
+    {"irc", "mode"},
+    {"irc", "kick"},
+    {"irc", "notice"},
+    {"irc", "join"},
+    {"irc", "part"},
+    {"irc", "settings"},
+    {"irc", "quit"},
+    {"irc", "backlogresponse"},
+    {"irc", "unread"},
+    {"irc", "members"},
+};
+static const int commandCount = sizeof(commandNames) / sizeof(commandNames[0]);
+
+const QHash<QString, int>& HarpoonDecoder::commandIndex() {
+    static const QHash<QString, int> index = [] {
+        QHash<QString, int> index;
+        for (int i = 0; i < commandCount; ++i)
+            index.insert(QLatin1String(commandNames[i].cmd), i);
+        return index;
+    }();
+    return index;
+}
+
+int HarpoonDecoder::findCommand(const QString& protocol, const QString& cmd) {
+    int command = commandIndex().value(cmd, -1);
+    if (command < 0 || protocol != QLatin1String(commandNames[command].protocol))
+        return -1;
+    return command;
+}
+
+template <typename Object>
+const HarpoonDecoder::DecodeFunction<Object>* HarpoonDecoder::commandTable() {
+    static const DecodeFunction<Object> table[] = {
+        &HarpoonDecoder::decodeLogin<Object>,
+        &HarpoonDecoder::decodeBatch<Object>,
+        &HarpoonDecoder::irc_decodeChatList<Object>,
+        &HarpoonDecoder::irc_decodeChat<Object>,
+        &HarpoonDecoder::irc_decodeUserList<Object>,
+        &HarpoonDecoder::irc_decodeNickChange<Object>,
+        &HarpoonDecoder::irc_decodeNickModified<Object>,
+        &HarpoonDecoder::irc_decodeServerAdded<Object>,
+        &HarpoonDecoder::irc_decodeServerDeleted<Object>,
+        &HarpoonDecoder::irc_decodeHostAdded<Object>,
+        &HarpoonDecoder::irc_decodeHostDeleted<Object>,
+        &HarpoonDecoder::irc_decodeTopic<Object>,
+        &HarpoonDecoder::irc_decodeAction<Object>,
+        &HarpoonDecoder::irc_decodeMode<Object>,
+        &HarpoonDecoder::irc_decodeKick<Object>,
+        &HarpoonDecoder::irc_decodeNotice<Object>,
+        &HarpoonDecoder::irc_decodeJoin<Object>,
+        &HarpoonDecoder::irc_decodePart<Object>,
+        &HarpoonDecoder::irc_decodeSettings<Object>,
+        &HarpoonDecoder::irc_decodeQuit<Object>,
+        &HarpoonDecoder::irc_decodeBacklogResponse<Object>,
+        &HarpoonDecoder::irc_decodeUnread<Object>,
+        &HarpoonDecoder::irc_decodeMembers<Object>,
+    };
+    static_assert(sizeof(table) / sizeof(table[0]) == commandCount, "commandNames and commandTable differ");
+    return table;
+}
+
+template <typename Object>
+bool HarpoonDecoder::readSymbol(const Object& root, QLatin1String key, QString& out) const {
+    typename FrameTraits<Object>::Value value = root.value(key);
+    if (isString(value)) {
+        out = toString(value);
+        return true;
+    }
+    if (!isNumber(value)) return false;
+
+    // a reference to an earlier definition, copying shares the string data
+    int symbol = toInt(value);
+    if (symbol < 0 || static_cast<size_t>(symbol) >= symbols_.size()) return false;
+    out = symbols_[symbol];
+    return true;
+}
+
+template <typename Object>
+void HarpoonDecoder::readDefinitions(const Object& root) {
+    typename FrameTraits<Object>::Value defValue = root.value(QLatin1String("def"));
+    if (!isArray(defValue)) return;
+
+    // ids are implicit, both sides count definitions from 0 per session
+    const typename FrameTraits<Object>::Array definitions = toArray(defValue);
+    for (typename FrameTraits<Object>::Value definition : definitions) {
+        if (symbols_.size() >= maxSymbols) {
+            qWarning() << "string dictionary is full";
+            return;
+        }
+        symbols_.push_back(isString(definition) ? toString(definition) : QString());
+        // a command name is resolved once, frames referring to it skip the lookup
+        symbolCommands_.push_back(commandIndex().value(symbols_.back(), -1));
+    }
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::decodeFrame(const Object& root) {
+    // definitions come first, the frame itself may already refer to them
+    readDefinitions(root);
+
+    typename FrameTraits<Object>::Value cmdValue = root.value(QLatin1String("cmd"));
+    typename FrameTraits<Object>::Value protocolValue = root.value(QLatin1String("protocol"));
+    QString protocol = isString(protocolValue) ? toString(protocolValue) : QString();
+    int command;
+    if (isNumber(cmdValue)) { // interned through the string dictionary
+        int symbol = toInt(cmdValue);
+        if (symbol < 0 || static_cast<size_t>(symbol) >= symbolCommands_.size()) return nullptr;
+        command = symbolCommands_[symbol];
+        if (command >= 0 && protocol != QLatin1String(commandNames[command].protocol))
+            command = -1;
+    } else if (isString(cmdValue)) {
+        command = findCommand(protocol, toString(cmdValue));
+    } else {
+        return nullptr;
+    }
+
+    if (command < 0) { // another protocol's command counts as unknown too
+        QString name = protocol + ":" + (isString(cmdValue) ? toString(cmdValue) : symbols_[toInt(cmdValue)]);
+        if (unknownCommandCounts_[name]++ == 0)
+            qWarning() << "unknown command" << name;
+        return nullptr;
+    }
+    return (this->*commandTable<Object>()[command])(root);
+}
+
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::decode(const QJsonObject& root) {
+    return decodeFrame(root);
+}
+
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::decode(const QCborMap& root) {
+    return decodeFrame(root);
+}
+
+#ifdef HARPOON_SIMDJSON
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::decode(const SimdJsonObject& root) {
+    return decodeFrame(root);
+}
+#endif
+
+void HarpoonDecoder::reset() {
+    symbols_.clear();
+    symbolCommands_.clear();
+}
+
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::decodeLogin(const Object& root) {
+    std::unique_ptr<LoginEvent> event{new LoginEvent};
+    if (!readBool(root, QLatin1String("success"), event->success))
+        return nullptr;
+
+    // optional list of protocol extensions the bouncer supports
+    typename FrameTraits<Object>::Value capsValue = root.value(QLatin1String("caps"));
+    if (isArray(capsValue)) {
+        const typename FrameTraits<Object>::Array caps = toArray(capsValue);
+        for (typename FrameTraits<Object>::Value cap : caps) {
+            if (isString(cap))
+                event->caps.push_back(toString(cap));
+        }
+    }
+
+    // optional session resumption, see HarpoonClient::onConnected
+    event->resumed = false;
+    readBool(root, QLatin1String("resumed"), event->resumed);
+    readString(root, QLatin1String("resumeToken"), event->resumeToken);
+    return std::move(event);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::decodeBatch(const Object& root) {
+    using Value = typename FrameTraits<Object>::Value;
+    using Array = typename FrameTraits<Object>::Array;
+    std::unique_ptr<BatchEvent> event{new BatchEvent};
+
+    Value eventsValue = root.value(QLatin1String("events"));
+    if (!isArray(eventsValue)) return nullptr;
+
+    const Array events = toArray(eventsValue);
+    event->events.reserve(events.size());
+    for (Value entry : events) {
+        if (!isObject(entry)) continue;
+        // a malformed entry only drops itself, not the whole batch
+        auto decoded = decodeFrame(toObject(entry));
+        if (decoded)
+            event->events.push_back(std::move(decoded));
+    }
+
+    return std::move(event);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeSettings(const Object& root) {
+    // TODO: hasPassword
+    using Value = typename FrameTraits<Object>::Value;
+    using Array = typename FrameTraits<Object>::Array;
+    std::unique_ptr<SettingsEvent> event{new SettingsEvent};
+
+    Value dataValue = root.value(QLatin1String("data"));
+    if (!isObject(dataValue)) return nullptr;
+    Object data = toObject(dataValue);
+
+    Value serversValue = data.value(QLatin1String("servers"));
+    if (!isObject(serversValue)) return nullptr;
+    Object servers = toObject(serversValue);
+
+    event->servers.reserve(servers.size());
+    for (auto serverIt = servers.constBegin(); serverIt != servers.constEnd(); ++serverIt) {
+        Value serverDataValue = serverIt.value();
+        if (!isObject(serverDataValue)) return nullptr;
+        Object serverData = toObject(serverDataValue);
+
+        Value hostsValue = serverData.value(QLatin1String("hosts"));
+        Value nicksValue = serverData.value(QLatin1String("nicks"));
+        if (!isObject(hostsValue)) return nullptr;
+        if (!isArray(nicksValue)) return nullptr;
+        Object hosts = toObject(hostsValue);
+        const Array nicks = toArray(nicksValue);
+
+        IrcServerSettings serverSettings;
+        serverSettings.serverId = keyOf(serverIt);
+        serverSettings.hosts.reserve(hosts.size());
+
+        for (auto hostIt = hosts.constBegin(); hostIt != hosts.constEnd(); ++hostIt) {
+            QString hostKey = keyOf(hostIt);
+            Value hostDataValue = hostIt.value();
+            if (!isObject(hostDataValue)) return nullptr;
+            Object hostData = toObject(hostDataValue);
+
+            bool hasPassword;
+            IrcHostEntry host;
+            if (!readBool(hostData, QLatin1String("hasPassword"), hasPassword)
+                || !readBool(hostData, QLatin1String("ipv6"), host.ipv6)
+                || !readBool(hostData, QLatin1String("ssl"), host.ssl))
+                return nullptr;
+
+            int colonPosition = hostKey.indexOf(":");
+            if (colonPosition == -1) return nullptr;
+            host.host = hostKey.left(colonPosition);
+            host.port = hostKey.right(hostKey.size() - colonPosition - 1).toInt();
+
+            serverSettings.hosts.push_back(host);
+        }
+
+        for (Value nickValue : nicks) {
+            if (!isString(nickValue)) return nullptr;
+            serverSettings.nicks.push_back(toString(nickValue));
+        }
+
+        event->servers.push_back(std::move(serverSettings));
+    }
+
+    return std::move(event);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeChatList(const Object& root) {
+    using Value = typename FrameTraits<Object>::Value;
+    std::unique_ptr<ChatListEvent> event{new ChatListEvent};
+
+    Value serversValue = root.value(QLatin1String("servers"));
+    if (!isObject(serversValue)) return nullptr;
+
+    Object servers = toObject(serversValue);
+    event->servers.reserve(servers.size());
+    for (auto sit = servers.constBegin(); sit != servers.constEnd(); ++sit) {
+        Value serverValue = sit.value();
+        if (!isObject(serverValue)) return nullptr;
+        Object server = toObject(serverValue);
+
+        IrcServerEntry serverEntry;
+        serverEntry.serverId = keyOf(sit);
+        if (!readString(server, QLatin1String("name"), serverEntry.name)
+            || !readString(server, QLatin1String("nick"), serverEntry.nick))
+            return nullptr;
+
+        Value channelsValue = server.value(QLatin1String("channels"));
+        if (!isObject(channelsValue)) return nullptr;
+
+        Object channels = toObject(channelsValue);
+        serverEntry.channels.reserve(channels.size());
+        for (auto cit = channels.constBegin(); cit != channels.constEnd(); ++cit) {
+            Value channelValue = cit.value();
+            if (!isObject(channelValue)) return nullptr;
+            Object channel = toObject(channelValue);
+
+            IrcChannelEntry channelEntry;
+            channelEntry.name = keyOf(cit);
+            Value channelDisabledValue = channel.value(QLatin1String("disabled"));
+            channelEntry.disabled = isBool(channelDisabledValue) && toBool(channelDisabledValue);
+            if (!readUsers(channel, QLatin1String("users"), channelEntry.users))
+                return nullptr;
+
+            serverEntry.channels.push_back(std::move(channelEntry));
+        }
+
+        event->servers.push_back(std::move(serverEntry));
+    }
+
+    return std::move(event);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeUserList(const Object& root) {
+    std::unique_ptr<UserListEvent> event{new UserListEvent};
+    if (!readSymbol(root, QLatin1String("server"), event->serverId)
+        || !readSymbol(root, QLatin1String("channel"), event->channel)
+        || !readUsers(root, QLatin1String("users"), event->users))
+        return nullptr;
+    return std::move(event);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeTopic(const Object& root) {
+    std::unique_ptr<TopicEvent> event{new TopicEvent};
+    if (!readId(root, QLatin1String("id"), event->id)
+        || !readDouble(root, QLatin1String("time"), event->time)
+        || !readSymbol(root, QLatin1String("server"), event->serverId)
+        || !readSymbol(root, QLatin1String("channel"), event->channel)
+        || !readSymbol(root, QLatin1String("nick"), event->nick)
+        || !readString(root, QLatin1String("topic"), event->topic))
+        return nullptr;
+    return std::move(event);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeChat(const Object& root) {
+    return irc_decodeChatLine(root, HarpoonEventType::IrcChat);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeNotice(const Object& root) {
+    return irc_decodeChatLine(root, HarpoonEventType::IrcNotice);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeAction(const Object& root) {
+    return irc_decodeChatLine(root, HarpoonEventType::IrcAction);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeChatLine(const Object& root, HarpoonEventType type) {
+    std::unique_ptr<ChatEvent> event{new ChatEvent{type}};
+    if (!readId(root, QLatin1String("id"), event->id)
+        || !readDouble(root, QLatin1String("time"), event->time)
+        || !readSymbol(root, QLatin1String("nick"), event->nick)
+        || !readString(root, QLatin1String("msg"), event->message)
+        || !readSymbol(root, QLatin1String("server"), event->serverId)
+        || !readSymbol(root, QLatin1String("channel"), event->channel))
+        return nullptr;
+    return std::move(event);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeMode(const Object& root) {
+    std::unique_ptr<ModeEvent> event{new ModeEvent};
+    if (!readId(root, QLatin1String("id"), event->id)
+        || !readDouble(root, QLatin1String("time"), event->time)
+        || !readSymbol(root, QLatin1String("server"), event->serverId)
+        || !readSymbol(root, QLatin1String("channel"), event->channel)
+        || !readSymbol(root, QLatin1String("nick"), event->nick)
+        || !readString(root, QLatin1String("mode"), event->mode))
+        return nullptr;
+
+    typename FrameTraits<Object>::Value argsValue = root.value(QLatin1String("args"));
+    if (!isArray(argsValue)) return nullptr;
+    const typename FrameTraits<Object>::Array args = toArray(argsValue);
+    for (typename FrameTraits<Object>::Value arg : args)
+        event->args.push_back(toString(arg));
+
+    return std::move(event);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeJoin(const Object& root) {
+    std::unique_ptr<JoinEvent> event{new JoinEvent};
+    if (!readId(root, QLatin1String("id"), event->id)
+        || !readDouble(root, QLatin1String("time"), event->time)
+        || !readSymbol(root, QLatin1String("nick"), event->nick)
+        || !readSymbol(root, QLatin1String("server"), event->serverId)
+        || !readSymbol(root, QLatin1String("channel"), event->channel))
+        return nullptr;
+    return std::move(event);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodePart(const Object& root) {
+    std::unique_ptr<PartEvent> event{new PartEvent};
+    if (!readId(root, QLatin1String("id"), event->id)
+        || !readDouble(root, QLatin1String("time"), event->time)
+        || !readSymbol(root, QLatin1String("nick"), event->nick)
+        || !readSymbol(root, QLatin1String("server"), event->serverId)
+        || !readSymbol(root, QLatin1String("channel"), event->channel))
+        return nullptr;
+    return std::move(event);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeNickChange(const Object& root) {
+    std::unique_ptr<NickChangeEvent> event{new NickChangeEvent};
+    if (!readId(root, QLatin1String("id"), event->id)
+        || !readDouble(root, QLatin1String("time"), event->time)
+        || !readSymbol(root, QLatin1String("nick"), event->nick)
+        || !readString(root, QLatin1String("newNick"), event->newNick)
+        || !readSymbol(root, QLatin1String("server"), event->serverId))
+        return nullptr;
+    return std::move(event);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeNickModified(const Object& root) {
+    std::unique_ptr<NickModifiedEvent> event{new NickModifiedEvent};
+    if (!readSymbol(root, QLatin1String("server"), event->serverId)
+        || !readString(root, QLatin1String("oldnick"), event->oldNick)
+        || !readString(root, QLatin1String("newnick"), event->newNick))
+        return nullptr;
+    return std::move(event);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeQuit(const Object& root) {
+    std::unique_ptr<QuitEvent> event{new QuitEvent};
+    if (!readId(root, QLatin1String("id"), event->id)
+        || !readDouble(root, QLatin1String("time"), event->time)
+        || !readSymbol(root, QLatin1String("nick"), event->nick)
+        || !readSymbol(root, QLatin1String("server"), event->serverId))
+        return nullptr;
+    return std::move(event);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeKick(const Object& root) {
+    std::unique_ptr<KickEvent> event{new KickEvent};
+    if (!readId(root, QLatin1String("id"), event->id)
+        || !readDouble(root, QLatin1String("time"), event->time)
+        || !readSymbol(root, QLatin1String("nick"), event->nick)
+        || !readSymbol(root, QLatin1String("server"), event->serverId)
+        || !readSymbol(root, QLatin1String("channel"), event->channel)
+        || !readSymbol(root, QLatin1String("target"), event->target)
+        || !readString(root, QLatin1String("msg"), event->reason))
+        return nullptr;
+    return std::move(event);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeServerAdded(const Object& root) {
+    std::unique_ptr<ServerAddedEvent> event{new ServerAddedEvent};
+    if (!readSymbol(root, QLatin1String("server"), event->serverId)
+        || !readString(root, QLatin1String("name"), event->name))
+        return nullptr;
+    return std::move(event);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeServerDeleted(const Object& root) {
+    std::unique_ptr<ServerDeletedEvent> event{new ServerDeletedEvent};
+    if (!readSymbol(root, QLatin1String("server"), event->serverId))
+        return nullptr;
+    return std::move(event);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeHostAdded(const Object& root) {
+    // TODO: has password
+    std::unique_ptr<HostAddedEvent> event{new HostAddedEvent};
+    if (!readSymbol(root, QLatin1String("server"), event->serverId)
+        || !readString(root, QLatin1String("host"), event->host.host)
+        || !readInt(root, QLatin1String("port"), event->host.port)
+        || !readBool(root, QLatin1String("ssl"), event->host.ssl)
+        || !readBool(root, QLatin1String("ipv6"), event->host.ipv6))
+        return nullptr;
+    return std::move(event);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeHostDeleted(const Object& root) {
+    std::unique_ptr<HostDeletedEvent> event{new HostDeletedEvent};
+    if (!readSymbol(root, QLatin1String("server"), event->serverId)
+        || !readString(root, QLatin1String("host"), event->host)
+        || !readInt(root, QLatin1String("port"), event->port))
+        return nullptr;
+    return std::move(event);
+}
+
+static BacklogLineType backlogLineType(const QString& type) {
+    if (type == "msg") return BacklogLineType::Message;
+    if (type == "join") return BacklogLineType::Join;
+    if (type == "part") return BacklogLineType::Part;
+    if (type == "quit") return BacklogLineType::Quit;
+    if (type == "kick") return BacklogLineType::Kick;
+    if (type == "notice") return BacklogLineType::Notice;
+    if (type == "action") return BacklogLineType::Action;
+    return BacklogLineType::Unknown;
+}
+
+// index into the columnar "types" array
+static BacklogLineType backlogLineType(int type) {
+    static const BacklogLineType types[] = {
+        BacklogLineType::Message,
+        BacklogLineType::Join,
+        BacklogLineType::Part,
+        BacklogLineType::Quit,
+        BacklogLineType::Kick,
+        BacklogLineType::Notice,
+        BacklogLineType::Action,
+    };
+    if (type < 0 || type >= static_cast<int>(sizeof(types) / sizeof(types[0])))
+        return BacklogLineType::Unknown;
+    return types[type];
+}
+
+// Columnar encoding, one array per field:
+//   ids, times: first value absolute, the rest deltas to the previous line
+//   types: indices, see backlogLineType(int)
+//   senders: distinct senders, sender: index into senders per line
+//   text: all messages as one utf-8 blob, ends: byte offset where each message ends
+template <typename Object>
+bool HarpoonDecoder::irc_decodeBacklogColumns(const Object& columns, std::vector<BacklogLine>& out) {
+    using Value = typename FrameTraits<Object>::Value;
+    using Array = typename FrameTraits<Object>::Array;
+
+    Value idsValue = columns.value(QLatin1String("ids"));
+    Value timesValue = columns.value(QLatin1String("times"));
+    Value typesValue = columns.value(QLatin1String("types"));
+    Value sendersValue = columns.value(QLatin1String("senders"));
+    Value senderValue = columns.value(QLatin1String("sender"));
+    Value textValue = columns.value(QLatin1String("text"));
+    Value endsValue = columns.value(QLatin1String("ends"));
+    if (!isArray(idsValue) || !isArray(timesValue) || !isArray(typesValue)
+        || !isArray(sendersValue) || !isArray(senderValue)
+        || !isBlob(textValue) || !isArray(endsValue))
+        return false;
+
+    const Array ids = toArray(idsValue);
+    const Array times = toArray(timesValue);
+    const Array types = toArray(typesValue);
+    const Array sender = toArray(senderValue);
+    const Array ends = toArray(endsValue);
+    const int count = ids.size();
+    if (times.size() != count || types.size() != count
+        || sender.size() != count || ends.size() != count)
+        return false;
+
+    std::vector<QString> senders;
+    const Array senderNames = toArray(sendersValue);
+    senders.reserve(senderNames.size());
+    for (Value name : senderNames) {
+        if (!isString(name)) return false;
+        senders.push_back(toString(name));
+    }
+
+    const QByteArray text = toBlob(textValue);
+    out.reserve(count);
+    qint64 id = 0;
+    double time = 0;
+    qint64 start = 0;
+    // the columns are walked side by side, simdjson arrays have no random access
+    auto idIt = ids.begin();
+    auto timeIt = times.begin();
+    auto typeIt = types.begin();
+    auto senderIt = sender.begin();
+    auto endIt = ends.begin();
+    for (int i = 0; i < count; ++i, ++idIt, ++timeIt, ++typeIt, ++senderIt, ++endIt) {
+        Value idValue = *idIt;
+        Value timeValue = *timeIt;
+        Value typeValue = *typeIt;
+        Value senderIndex = *senderIt;
+        Value endValue = *endIt;
+        if (!isNumber(idValue) || !isNumber(timeValue) || !isNumber(typeValue)
+            || !isNumber(senderIndex) || !isNumber(endValue))
+            return false;
+
+        qint64 idDelta = toInteger(idValue);
+        if (i > 0 && idDelta <= 0) return false; // ids are strictly ascending
+        id = i == 0 ? idDelta : id + idDelta;
+        time = i == 0 ? toDouble(timeValue) : time + toDouble(timeValue);
+
+        int senderId = toInt(senderIndex);
+        qint64 end = toInteger(endValue);
+        if (id < 0 || senderId < 0 || static_cast<size_t>(senderId) >= senders.size()
+            || end < start || end > text.size())
+            return false;
+
+        BacklogLine line;
+        line.id = static_cast<size_t>(id);
+        line.time = time;
+        line.type = backlogLineType(toInt(typeValue));
+        line.sender = senders[senderId];
+        line.message = QString::fromUtf8(text.constData() + start, static_cast<int>(end - start));
+        out.push_back(std::move(line));
+        start = end;
+    }
+    return true;
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeBacklogResponse(const Object& root) {
+    using Value = typename FrameTraits<Object>::Value;
+    using Array = typename FrameTraits<Object>::Array;
+    std::unique_ptr<BacklogEvent> event{new BacklogEvent};
+    if (!readSymbol(root, QLatin1String("server"), event->serverId)
+        || !readSymbol(root, QLatin1String("channel"), event->channel))
+        return nullptr;
+
+    Value columnsValue = root.value(QLatin1String("columns"));
+    if (isObject(columnsValue)) {
+        if (!irc_decodeBacklogColumns(toObject(columnsValue), event->lines))
+            return nullptr;
+        return std::move(event);
+    }
+
+    Value linesValue = root.value(QLatin1String("lines"));
+    if (!isArray(linesValue)) return nullptr;
+
+    const Array lines = toArray(linesValue);
+    event->lines.reserve(lines.size());
+    for (Value line : lines) {
+        if (!isObject(line)) return nullptr;
+
+        Object entry = toObject(line);
+        BacklogLine backlogLine;
+        QString type;
+        if (!readId(entry, QLatin1String("id"), backlogLine.id)
+            || !readString(entry, QLatin1String("msg"), backlogLine.message)
+            || !readSymbol(entry, QLatin1String("sender"), backlogLine.sender)
+            || !readString(entry, QLatin1String("type"), type)
+            || !readDouble(entry, QLatin1String("time"), backlogLine.time))
+            return nullptr;
+        backlogLine.type = backlogLineType(type);
+
+        event->lines.push_back(std::move(backlogLine));
+    }
+
+    return std::move(event);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeUnread(const Object& root) {
+    std::unique_ptr<UnreadEvent> event{new UnreadEvent};
+    if (!readSymbol(root, QLatin1String("server"), event->serverId)
+        || !readSymbol(root, QLatin1String("channel"), event->channel)
+        || !readInt(root, QLatin1String("unread"), event->unread)
+        || !readInt(root, QLatin1String("highlights"), event->highlights))
+        return nullptr;
+    return std::move(event);
+}
+
+template <typename Object>
+std::unique_ptr<HarpoonEvent> HarpoonDecoder::irc_decodeMembers(const Object& root) {
+    std::unique_ptr<MembersEvent> event{new MembersEvent};
+    if (!readSymbol(root, QLatin1String("server"), event->serverId)
+        || !readSymbol(root, QLatin1String("channel"), event->channel))
+        return nullptr;
+
+    // either list may be left out
+    readStringList(root, QLatin1String("joined"), event->joined);
+    readStringList(root, QLatin1String("parted"), event->parted);
+    return std::move(event);
+}
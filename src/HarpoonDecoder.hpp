@@ -0,0 +1,78 @@
+#ifndef HARPOONDECODER_H
+#define HARPOONDECODER_H
+
+#include <QString>
+#include <QHash>
+#include <memory>
+#include <vector>
+
+#include "HarpoonEvent.hpp"
+#include "SimdJsonFrame.hpp"
+
+
+class QJsonObject;
+class QCborMap;
+
+
+// Turns a frame into a typed event in a single validation pass.
+// Runs on the network thread; returns nullptr for malformed or unknown frames,
+// unknown commands are logged once per name. Frames may define strings in a "def" list,
+// later frames refer to server, channel and nick strings by their index.
+class HarpoonDecoder {
+    template <typename Object>
+    using DecodeFunction = std::unique_ptr<HarpoonEvent> (HarpoonDecoder::*)(const Object& root);
+
+    QHash<QString, size_t> unknownCommandCounts_;
+    std::vector<QString> symbols_; // session string dictionary, indexed by id
+    std::vector<int> symbolCommands_; // command a symbol names, -1 if none
+
+    template <typename Object> bool readSymbol(const Object& root, QLatin1String key, QString& out) const;
+    template <typename Object> void readDefinitions(const Object& root);
+
+    static const QHash<QString, int>& commandIndex();
+    template <typename Object> static const DecodeFunction<Object>* commandTable();
+    template <typename Object> std::unique_ptr<HarpoonEvent> decodeFrame(const Object& root);
+
+    template <typename Object> std::unique_ptr<HarpoonEvent> decodeLogin(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> decodeBatch(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeSettings(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeChatList(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeUserList(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeTopic(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeChatLine(const Object& root, HarpoonEventType type);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeChat(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeNotice(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeAction(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeMode(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeJoin(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodePart(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeNickChange(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeNickModified(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeQuit(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeKick(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeServerAdded(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeServerDeleted(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeHostAdded(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeHostDeleted(const Object& root);
+    template <typename Object> bool irc_decodeBacklogColumns(const Object& columns, std::vector<BacklogLine>& out);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeBacklogResponse(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeUnread(const Object& root);
+    template <typename Object> std::unique_ptr<HarpoonEvent> irc_decodeMembers(const Object& root);
+
+public:
+    HarpoonDecoder();
+
+    static bool parseId(const QString& text, size_t& id);
+    // index into the command table, -1 if unknown or of another protocol
+    static int findCommand(const QString& protocol, const QString& cmd);
+
+    std::unique_ptr<HarpoonEvent> decode(const QJsonObject& root);
+    std::unique_ptr<HarpoonEvent> decode(const QCborMap& root);
+#ifdef HARPOON_SIMDJSON
+    std::unique_ptr<HarpoonEvent> decode(const SimdJsonObject& root);
+#endif
+    void reset(); // forgets the string dictionary, called for every new session
+};
+
+
+#endif
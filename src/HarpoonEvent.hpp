@@ -0,0 +1,279 @@
+#ifndef HARPOONEVENT_H
+#define HARPOONEVENT_H
+
+#include <QString>
+#include <QStringList>
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+
+enum class HarpoonEventType {
+    Connected,
+    Disconnected,
+    Latency,
+    Login,
+    Batch,
+    IrcSettings,
+    IrcChatList,
+    IrcUserList,
+    IrcTopic,
+    IrcChat,
+    IrcNotice,
+    IrcAction,
+    IrcMode,
+    IrcJoin,
+    IrcPart,
+    IrcNickChange,
+    IrcNickModified,
+    IrcQuit,
+    IrcKick,
+    IrcServerAdded,
+    IrcServerDeleted,
+    IrcHostAdded,
+    IrcHostDeleted,
+    IrcBacklogResponse,
+    IrcUnread,
+    IrcMembers
+};
+
+// Events are decoded and validated on the network thread, the handlers on
+// the gui thread only see fully populated structs.
+struct HarpoonEvent {
+    HarpoonEventType type;
+
+    explicit HarpoonEvent(HarpoonEventType type)
+        : type{type}
+    {
+    }
+    virtual ~HarpoonEvent() {}
+};
+
+struct ConnectedEvent : HarpoonEvent {
+    ConnectedEvent() : HarpoonEvent{HarpoonEventType::Connected} {}
+    int handshakeTime; // milliseconds from open until the websocket was up
+};
+
+// smoothed websocket ping round trip
+struct LatencyEvent : HarpoonEvent {
+    LatencyEvent() : HarpoonEvent{HarpoonEventType::Latency} {}
+    int rtt; // milliseconds
+};
+
+struct LoginEvent : HarpoonEvent {
+    LoginEvent() : HarpoonEvent{HarpoonEventType::Login} {}
+    bool success;
+    QStringList caps;
+    bool resumed; // a RESUME was accepted, only missed events follow
+    QString resumeToken; // empty if the bouncer doesn't offer resumption
+};
+
+// several events applied as one transaction
+struct BatchEvent : HarpoonEvent {
+    BatchEvent() : HarpoonEvent{HarpoonEventType::Batch} {}
+    std::vector<std::unique_ptr<HarpoonEvent>> events;
+};
+
+struct IrcUserEntry {
+    QString nick;
+    QString mode;
+};
+
+struct IrcHostEntry {
+    QString host;
+    int port;
+    bool ssl;
+    bool ipv6;
+};
+
+struct IrcServerSettings {
+    QString serverId;
+    std::vector<IrcHostEntry> hosts;
+    QStringList nicks;
+};
+
+struct SettingsEvent : HarpoonEvent {
+    SettingsEvent() : HarpoonEvent{HarpoonEventType::IrcSettings} {}
+    std::vector<IrcServerSettings> servers;
+};
+
+struct IrcChannelEntry {
+    QString name;
+    bool disabled;
+    std::vector<IrcUserEntry> users;
+};
+
+struct IrcServerEntry {
+    QString serverId;
+    QString name;
+    QString nick;
+    std::vector<IrcChannelEntry> channels;
+};
+
+struct ChatListEvent : HarpoonEvent {
+    ChatListEvent() : HarpoonEvent{HarpoonEventType::IrcChatList} {}
+    std::vector<IrcServerEntry> servers;
+};
+
+struct UserListEvent : HarpoonEvent {
+    UserListEvent() : HarpoonEvent{HarpoonEventType::IrcUserList} {}
+    QString serverId;
+    QString channel;
+    std::vector<IrcUserEntry> users;
+};
+
+struct TopicEvent : HarpoonEvent {
+    TopicEvent() : HarpoonEvent{HarpoonEventType::IrcTopic} {}
+    size_t id;
+    double time;
+    QString serverId;
+    QString channel;
+    QString nick;
+    QString topic;
+};
+
+// chat, notice and action share the same layout
+struct ChatEvent : HarpoonEvent {
+    explicit ChatEvent(HarpoonEventType type) : HarpoonEvent{type} {}
+    size_t id;
+    double time;
+    QString serverId;
+    QString channel;
+    QString nick;
+    QString message;
+};
+
+struct ModeEvent : HarpoonEvent {
+    ModeEvent() : HarpoonEvent{HarpoonEventType::IrcMode} {}
+    size_t id;
+    double time;
+    QString serverId;
+    QString channel;
+    QString nick;
+    QString mode;
+    QStringList args;
+};
+
+struct JoinEvent : HarpoonEvent {
+    JoinEvent() : HarpoonEvent{HarpoonEventType::IrcJoin} {}
+    size_t id;
+    double time;
+    QString serverId;
+    QString channel;
+    QString nick;
+};
+
+struct PartEvent : HarpoonEvent {
+    PartEvent() : HarpoonEvent{HarpoonEventType::IrcPart} {}
+    size_t id;
+    double time;
+    QString serverId;
+    QString channel;
+    QString nick;
+};
+
+struct NickChangeEvent : HarpoonEvent {
+    NickChangeEvent() : HarpoonEvent{HarpoonEventType::IrcNickChange} {}
+    size_t id;
+    double time;
+    QString serverId;
+    QString nick;
+    QString newNick;
+};
+
+struct NickModifiedEvent : HarpoonEvent {
+    NickModifiedEvent() : HarpoonEvent{HarpoonEventType::IrcNickModified} {}
+    QString serverId;
+    QString oldNick;
+    QString newNick;
+};
+
+struct QuitEvent : HarpoonEvent {
+    QuitEvent() : HarpoonEvent{HarpoonEventType::IrcQuit} {}
+    size_t id;
+    double time;
+    QString serverId;
+    QString nick;
+};
+
+struct KickEvent : HarpoonEvent {
+    KickEvent() : HarpoonEvent{HarpoonEventType::IrcKick} {}
+    size_t id;
+    double time;
+    QString serverId;
+    QString channel;
+    QString nick;
+    QString target;
+    QString reason;
+};
+
+struct ServerAddedEvent : HarpoonEvent {
+    ServerAddedEvent() : HarpoonEvent{HarpoonEventType::IrcServerAdded} {}
+    QString serverId;
+    QString name;
+};
+
+struct ServerDeletedEvent : HarpoonEvent {
+    ServerDeletedEvent() : HarpoonEvent{HarpoonEventType::IrcServerDeleted} {}
+    QString serverId;
+};
+
+struct HostAddedEvent : HarpoonEvent {
+    HostAddedEvent() : HarpoonEvent{HarpoonEventType::IrcHostAdded} {}
+    QString serverId;
+    IrcHostEntry host;
+};
+
+struct HostDeletedEvent : HarpoonEvent {
+    HostDeletedEvent() : HarpoonEvent{HarpoonEventType::IrcHostDeleted} {}
+    QString serverId;
+    QString host;
+    int port;
+};
+
+enum class BacklogLineType {
+    Unknown,
+    Message,
+    Join,
+    Part,
+    Quit,
+    Kick,
+    Notice,
+    Action
+};
+
+struct BacklogLine {
+    size_t id;
+    double time;
+    BacklogLineType type;
+    QString sender;
+    QString message;
+};
+
+struct BacklogEvent : HarpoonEvent {
+    BacklogEvent() : HarpoonEvent{HarpoonEventType::IrcBacklogResponse} {}
+    QString serverId;
+    QString channel;
+    std::vector<BacklogLine> lines;
+};
+
+// counters for a channel that is not subscribed to full events
+struct UnreadEvent : HarpoonEvent {
+    UnreadEvent() : HarpoonEvent{HarpoonEventType::IrcUnread} {}
+    QString serverId;
+    QString channel;
+    int unread;
+    int highlights;
+};
+
+// membership changes without backlog lines, sent for filtered join/part/quit
+struct MembersEvent : HarpoonEvent {
+    MembersEvent() : HarpoonEvent{HarpoonEventType::IrcMembers} {}
+    QString serverId;
+    QString channel;
+    QStringList joined;
+    QStringList parted;
+};
+
+
+#endif
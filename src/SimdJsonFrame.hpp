@@ -0,0 +1,160 @@
+#ifndef SIMDJSONFRAME_H
+#define SIMDJSONFRAME_H
+
+#ifdef HARPOON_SIMDJSON
+
+#include <QString>
+#include <QByteArray>
+#include <QLatin1String>
+#include <string_view>
+#include <simdjson.h>
+
+
+// Read-only views into a document parsed by simdjson, shaped like the
+// QJsonObject accessors the decoder uses. They point into the parser's
+// tape and are only valid until the parser is used again.
+class SimdJsonObject;
+class SimdJsonArray;
+
+class SimdJsonValue {
+    simdjson::dom::element element_;
+    bool valid_; // false for missing keys
+
+public:
+    SimdJsonValue() : valid_{false} {}
+    explicit SimdJsonValue(simdjson::dom::element element) : element_(element), valid_{true} {}
+
+    bool isString() const { return valid_ && element_.is_string(); }
+    bool isNumber() const { return valid_ && element_.is_number(); }
+    bool isInteger() const { return valid_ && (element_.is_int64() || element_.is_uint64()); }
+    bool isBool() const { return valid_ && element_.is_bool(); }
+    bool isObject() const { return valid_ && element_.is_object(); }
+    bool isArray() const { return valid_ && element_.is_array(); }
+
+    QString toString() const {
+        std::string_view text;
+        if (!valid_ || element_.get_string().get(text)) return QString();
+        return QString::fromUtf8(text.data(), static_cast<int>(text.size()));
+    }
+    QByteArray toUtf8() const {
+        std::string_view text;
+        if (!valid_ || element_.get_string().get(text)) return QByteArray();
+        return QByteArray(text.data(), static_cast<int>(text.size()));
+    }
+    double toDouble() const {
+        double value = 0;
+        if (!valid_ || element_.get_double().get(value)) return 0;
+        return value;
+    }
+    qint64 toInteger() const {
+        int64_t value;
+        if (valid_ && !element_.get_int64().get(value)) return value;
+        return static_cast<qint64>(toDouble());
+    }
+    bool toBool() const {
+        bool value = false;
+        if (!valid_ || element_.get_bool().get(value)) return false;
+        return value;
+    }
+
+    SimdJsonObject toObject() const;
+    SimdJsonArray toArray() const;
+};
+
+// The tape only allows sequential access, so there is no at(i).
+class SimdJsonArray {
+    simdjson::dom::array array_;
+    bool valid_;
+
+public:
+    class const_iterator {
+        simdjson::dom::array::iterator it_;
+        bool valid_;
+
+    public:
+        const_iterator() : valid_{false} {}
+        explicit const_iterator(simdjson::dom::array::iterator it) : it_(it), valid_{true} {}
+
+        SimdJsonValue operator*() const { return SimdJsonValue(*it_); }
+        const_iterator& operator++() { ++it_; return *this; }
+        bool operator!=(const const_iterator& other) const {
+            if (!valid_ || !other.valid_) return valid_ != other.valid_;
+            return it_ != other.it_;
+        }
+    };
+
+    SimdJsonArray() : valid_{false} {}
+    explicit SimdJsonArray(simdjson::dom::array array) : array_(array), valid_{true} {}
+
+    int size() const { return valid_ ? static_cast<int>(array_.size()) : 0; }
+    const_iterator begin() const { return valid_ ? const_iterator(array_.begin()) : const_iterator(); }
+    const_iterator end() const { return valid_ ? const_iterator(array_.end()) : const_iterator(); }
+};
+
+class SimdJsonObject {
+    simdjson::dom::object object_;
+    bool valid_;
+
+public:
+    class ConstIterator {
+        simdjson::dom::object::iterator it_;
+        bool valid_;
+
+    public:
+        ConstIterator() : valid_{false} {}
+        explicit ConstIterator(simdjson::dom::object::iterator it) : it_(it), valid_{true} {}
+
+        QString key() const {
+            std::string_view key = it_.key();
+            return QString::fromUtf8(key.data(), static_cast<int>(key.size()));
+        }
+        SimdJsonValue value() const { return SimdJsonValue(it_.value()); }
+        ConstIterator& operator++() { ++it_; return *this; }
+        bool operator!=(const ConstIterator& other) const {
+            if (!valid_ || !other.valid_) return valid_ != other.valid_;
+            return it_ != other.it_;
+        }
+    };
+
+    SimdJsonObject() : valid_{false} {}
+    explicit SimdJsonObject(simdjson::dom::object object) : object_(object), valid_{true} {}
+
+    SimdJsonValue value(QLatin1String key) const {
+        simdjson::dom::element element;
+        if (!valid_ || object_.at_key(std::string_view(key.data(), key.size())).get(element))
+            return SimdJsonValue();
+        return SimdJsonValue(element);
+    }
+    int size() const { return valid_ ? static_cast<int>(object_.size()) : 0; }
+    ConstIterator constBegin() const { return valid_ ? ConstIterator(object_.begin()) : ConstIterator(); }
+    ConstIterator constEnd() const { return valid_ ? ConstIterator(object_.end()) : ConstIterator(); }
+
+    // parses a utf-8 frame, the parser copies it into a padded buffer if needed
+    static bool parse(simdjson::dom::parser& parser, const QByteArray& data, SimdJsonObject& root) {
+        simdjson::dom::element element;
+        if (parser.parse(data.constData(), static_cast<size_t>(data.size())).get(element))
+            return false;
+        simdjson::dom::object object;
+        if (element.get_object().get(object))
+            return false;
+        root = SimdJsonObject(object);
+        return true;
+    }
+};
+
+inline SimdJsonObject SimdJsonValue::toObject() const {
+    simdjson::dom::object object;
+    if (!valid_ || element_.get_object().get(object)) return SimdJsonObject();
+    return SimdJsonObject(object);
+}
+
+inline SimdJsonArray SimdJsonValue::toArray() const {
+    simdjson::dom::array array;
+    if (!valid_ || element_.get_array().get(array)) return SimdJsonArray();
+    return SimdJsonArray(array);
+}
+
+
+#endif
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+
+// bounded lock-free ring buffer for one producer and one consumer thread
+template <typename T>
+class SpscQueue {
+    std::vector<T> slots_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_; // next slot to read, owned by the consumer
+    alignas(64) std::atomic<size_t> tail_; // next slot to write, owned by the producer
+
+    static size_t roundCapacity(size_t capacity) {
+        size_t rounded = 1;
+        while (rounded < capacity)
+            rounded <<= 1;
+        return rounded;
+    }
+
+public:
+    explicit SpscQueue(size_t capacity)
+        : slots_(roundCapacity(capacity))
+        , mask_{slots_.size() - 1}
+        , head_{0}
+        , tail_{0}
+    {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // producer side; returns false if the queue is full
+    bool push(T&& value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == slots_.size())
+            return false;
+        slots_[tail & mask_] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side; returns false if the queue is empty
+    bool pop(T& value) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+        value = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+};
+
+
+#endif
@@ -1,14 +1,30 @@
 #include "IrcBacklogView.hpp"
 #include "moc_IrcBacklogView.cpp"
 
-#include <QTextBlockFormat>
-#include <QTextCursor>
 #include <QScrollBar>
+#include <QTextBlock>
+#include <QTextLayout>
+#include <algorithm>
+#include <limits>
+
+
+// rows outside the viewport that keep their render items
+static const size_t overscanRows = 8;
+// live lines are inserted once per frame, hidden views catch up less often
+static const int frameInterval = 16;
+static const int hiddenInterval = 250;
 
 
 IrcBacklogView::IrcBacklogView(QGraphicsScene* scene)
     : QGraphicsView(scene)
     , splitting_{75, 0.2, 0.8}
+    , measuredWidths_{{-1, -1, -1}}
+    , timestampHeight_{0}
+    , updateDepth_{0}
+    , layoutPending_{false}
+    , scrollPending_{false}
+    , anchorId_{0}
+    , anchorOffset_{0}
 {
     for (auto& handle : handles)
         scene->addItem(&handle);
@@ -32,6 +48,9 @@ IrcBacklogView::IrcBacklogView(QGraphicsScene* scene)
             updateLayout(false, false);
         });
 
+    flushTimer_.setSingleShot(true);
+    connect(&flushTimer_, &QTimer::timeout, this, &IrcBacklogView::flushPendingLines);
+
     setAcceptDrops(true);
 }
 
@@ -44,51 +63,135 @@ void IrcBacklogView::mousePressEvent(QMouseEvent* event) {
     QGraphicsView::mousePressEvent(event);
 }
 
-void IrcBacklogView::updateLayout(bool moveHandle1, bool moveHandle2) {
-    auto contentsRect = this->contentsRect();
-    qreal width = contentsRect.width();
-    qreal timeWidth = splitting_[0]; // time is fixed width
+void IrcBacklogView::showEvent(QShowEvent* event) {
+    QGraphicsView::showEvent(event);
+    flushPendingLines(); // don't show a stale view until the slow timer fires
+}
+
+void IrcBacklogView::scrollContentsBy(int dx, int dy) {
+    QGraphicsView::scrollContentsBy(dx, dy);
+    updateVisibleRows();
+}
+
+void IrcBacklogView::columnWidths(qreal& timeWidth, qreal& whoWidth, qreal& messageWidth) const {
+    qreal width = contentsRect().width();
+    timeWidth = splitting_[0]; // time is fixed width
     width -= splitting_[0];
-    qreal whoWidth = splitting_[1] * width;
-    qreal messageWidth = splitting_[2] * width;
-
-    int top = 0;
-    for (auto& line : chatLines_) {
-        int left = 0;
-        auto* timestampGfx = line.getTimestampGfx();
-        auto* whoGfx = line.getWhoGfx();
-        auto* messageGfx = line.getMessageGfx();
-        timestampGfx->setTextWidth(timeWidth);
-        whoGfx->setTextWidth(whoWidth);
-        messageGfx->setTextWidth(messageWidth);
-
-        timestampGfx->setPos(left, top);
-        left += timeWidth;
-        whoGfx->setPos(left, top);
-        left += whoWidth;
-        messageGfx->setPos(left, top);
-
-        // nick col: align right
-        QTextBlockFormat format;
-        format.setAlignment(Qt::AlignRight);
-        QTextCursor cursor = whoGfx->textCursor();
-        cursor.select(QTextCursor::Document);
-        cursor.mergeBlockFormat(format);
-        cursor.clearSelection();
-        whoGfx->setTextCursor(cursor);
-
-        top += std::max({timestampGfx->boundingRect().height(), whoGfx->boundingRect().height(), messageGfx->boundingRect().height()});
+    whoWidth = splitting_[1] * width;
+    messageWidth = splitting_[2] * width;
+}
+
+qreal IrcBacklogView::measureText(const QString& text, qreal width, qreal& fit) {
+    measureDocument_.setTextWidth(width);
+    measureDocument_.setPlainText(text);
+    qreal height = measureDocument_.size().height(); // lays the document out
+
+    QTextLayout* layout = measureDocument_.firstBlock().layout();
+    if (measureDocument_.blockCount() == 1 && layout != nullptr && layout->lineCount() == 1)
+        fit = measureDocument_.idealWidth() + 2 * measureDocument_.documentMargin();
+    else
+        fit = std::numeric_limits<qreal>::infinity();
+    return height;
+}
+
+void IrcBacklogView::measureLine(IrcChatLine& line) {
+    qreal whoFit, messageFit;
+    qreal whoHeight = measureText(line.getWhoRef(), measuredWidths_[1], whoFit);
+    qreal messageHeight = measureText(line.getMessageRef(), measuredWidths_[2], messageFit);
+    line.setMeasure(std::max(whoHeight, messageHeight), whoFit, messageFit);
+    line.setHeight(std::max(timestampHeight_, line.getTextHeight()));
+}
+
+void IrcBacklogView::updateWidths() {
+    std::array<qreal, 3> widths;
+    columnWidths(widths[0], widths[1], widths[2]);
+    if (widths == measuredWidths_) return;
+
+    bool timeChanged = widths[0] != measuredWidths_[0];
+    measuredWidths_ = widths;
+    measureDocument_.setDefaultFont(scene()->font());
+    if (timeChanged) {
+        qreal fit;
+        timestampHeight_ = measureText("[00:00:00]", widths[0], fit);
     }
 
-    qreal height = std::max(top, viewport()->height());
+    // only lines whose wrapping may change are measured again
+    chatLines_.forEachLine([this, &widths](IrcChatLine& line) {
+            if (line.getTextHeight() < 0 || !line.fits(widths[1], widths[2]))
+                measureLine(line);
+            else
+                line.setHeight(std::max(timestampHeight_, line.getTextHeight()));
+        });
+    chatLines_.updateTops();
+}
+
+void IrcBacklogView::updateLayout(bool moveHandle1, bool moveHandle2) {
+    updateWidths();
+
+    qreal top = chatLines_.top();
+    qreal height = std::max(chatLines_.bottom() - top, static_cast<qreal>(viewport()->height()));
+    scene()->setSceneRect(0, top, viewport()->width(), height);
+
     if (moveHandle1) {
-        handles[0].setRect(QRect(-GraphicsHandle::handleWidth/2, 0, GraphicsHandle::handleWidth/2, height));
-        handles[0].setPos(timeWidth, 0);
+        handles[0].setRect(QRectF(-GraphicsHandle::handleWidth/2, top, GraphicsHandle::handleWidth/2, height));
+        handles[0].setPos(measuredWidths_[0], 0);
     }
     if (moveHandle2) {
-        handles[1].setRect(QRect(-GraphicsHandle::handleWidth/2, 0, GraphicsHandle::handleWidth/2, height));
-        handles[1].setPos(timeWidth+whoWidth, 0);
+        handles[1].setRect(QRectF(-GraphicsHandle::handleWidth/2, top, GraphicsHandle::handleWidth/2, height));
+        handles[1].setPos(measuredWidths_[0]+measuredWidths_[1], 0);
+    }
+
+    updateVisibleRows();
+}
+
+void IrcBacklogView::updateVisibleRows() {
+    qreal timeWidth, whoWidth, messageWidth;
+    columnWidths(timeWidth, whoWidth, messageWidth);
+
+    QHash<size_t, IrcChatLineItem*> visible;
+    std::vector<IrcChatLineItem*> unnumbered;
+    if (!chatLines_.empty()) {
+        qreal viewTop = mapToScene(0, 0).y();
+        qreal viewBottom = viewTop + viewport()->height();
+        size_t topRow = chatLines_.rowAt(viewTop);
+        size_t bottomRow = chatLines_.rowAt(viewBottom);
+        size_t first = topRow > overscanRows ? topRow - overscanRows : 0;
+        size_t last = std::min(chatLines_.size(), bottomRow + 1 + overscanRows);
+
+        for (size_t i = first; i < last; ++i) {
+            const IrcChatLine& line = chatLines_.at(i);
+            // id 0 isn't unique, such lines are always rebuilt
+            IrcChatLineItem* item = line.getId() != 0 ? visibleItems_.take(line.getId()) : nullptr;
+            if (!item) {
+                if (freeItems_.empty()) {
+                    items_.emplace_back(new IrcChatLineItem(scene()));
+                    item = items_.back().get();
+                } else {
+                    item = freeItems_.back();
+                    freeItems_.pop_back();
+                    item->setVisible(true);
+                }
+                item->setLine(line);
+            }
+            item->setGeometry(chatLines_.lineTop(i), timeWidth, whoWidth, messageWidth);
+            if (line.getId() != 0)
+                visible.insert(line.getId(), item);
+            else
+                unnumbered.push_back(item);
+        }
+    }
+
+    // whatever scrolled out is recycled
+    for (IrcChatLineItem* item : visibleItems_) {
+        item->setVisible(false);
+        freeItems_.push_back(item);
     }
+    for (IrcChatLineItem* item : visibleUnnumbered_) {
+        item->setVisible(false);
+        freeItems_.push_back(item);
+    }
+    visibleItems_.swap(visible);
+    visibleUnnumbered_.swap(unnumbered);
 }
 
 void IrcBacklogView::addMessage(size_t id,
@@ -97,34 +200,99 @@ void IrcBacklogView::addMessage(size_t id,
                              const QString& message,
                              const MessageColor color,
                              bool bUpdateLayout){
+    if (id != 0 && (chatLines_.contains(id) || pendingIds_.contains(id)))
+        return; // message already exists
+
+    if (updateDepth_ == 0 && bUpdateLayout) {
+        // a flood costs one layout per frame instead of one per line
+        pendingLines_.emplace_back(id, time, nick, message, color);
+        if (id != 0)
+            pendingIds_.insert(id);
+        if (!flushTimer_.isActive())
+            flushTimer_.start(isVisible() ? frameInterval : hiddenInterval);
+        return;
+    }
+
+    beginUpdate();
+    // only the new line is measured, the store places it by id
+    updateWidths();
+    IrcChatLine line(id, time, nick, message, color);
+    measureLine(line);
+    chatLines_.insert(std::move(line));
+    if (bUpdateLayout)
+        layoutPending_ = true;
+    endUpdate();
+}
+
+void IrcBacklogView::addMessages(std::vector<IrcChatLine>&& lines) {
+    if (lines.empty()) return;
+
+    beginUpdate();
+    updateWidths();
+    if (!std::is_sorted(lines.begin(), lines.end(), [](const IrcChatLine& a, const IrcChatLine& b) { return a.getId() < b.getId(); }))
+        std::stable_sort(lines.begin(), lines.end(), [](const IrcChatLine& a, const IrcChatLine& b) { return a.getId() < b.getId(); });
+    for (auto& line : lines) {
+        if (line.getId() == 0 || !chatLines_.contains(line.getId()))
+            measureLine(line);
+    }
+    chatLines_.insert(std::move(lines));
+    layoutPending_ = true;
+    endUpdate();
+}
+
+void IrcBacklogView::flushPendingLines() {
+    flushTimer_.stop();
+    if (pendingLines_.empty()) return;
+
+    std::vector<IrcChatLine> lines;
+    lines.swap(pendingLines_);
+    pendingIds_.clear();
+
+    // live lines go to the end of the store, inserting them one by one
+    // keeps its blocks full, the layout still happens once
+    beginUpdate();
+    updateWidths();
+    for (auto& line : lines) {
+        if (line.getId() != 0 && chatLines_.contains(line.getId()))
+            continue; // came in with a backlog page meanwhile
+        measureLine(line);
+        chatLines_.insert(std::move(line));
+    }
+    layoutPending_ = true;
+    endUpdate();
+}
+
+void IrcBacklogView::beginUpdate() {
+    if (updateDepth_++ > 0) return;
+
     QScrollBar* bar = this->verticalScrollBar();
-    bool scrollToBottom = bar != nullptr && bar->sliderPosition() == bar->maximum();
-
-    IrcChatLine* line;
-    if (id == 0 || chatLines_.size() == 0 || id > chatLines_.back().getId()) {
-        chatLines_.emplace_back(id, time, nick, message, color);
-        line = &chatLines_.back();
-    } else if (id < chatLines_.front().getId()) {
-        chatLines_.emplace_front(id, time, nick, message, color);
-        line = &chatLines_.front();
-    } else {
-        auto it = chatLines_.begin();
-        while (it != chatLines_.end() && id > it->getId()) {
-            ++it;
-        }
-        if (id == it->getId())
-            return; // message already exists
-        chatLines_.emplace(it, id, time, nick, message, color);
+    scrollPending_ = bar != nullptr && bar->sliderPosition() == bar->maximum();
+    layoutPending_ = false;
+
+    anchorId_ = 0;
+    if (!scrollPending_ && !chatLines_.empty()) {
+        qreal viewTop = mapToScene(0, 0).y();
+        size_t row = chatLines_.rowAt(viewTop);
+        anchorId_ = chatLines_.at(row).getId();
+        anchorOffset_ = viewTop - chatLines_.lineTop(row);
     }
+}
 
-    QGraphicsScene* scene = this->scene();
-    scene->addItem(line->getTimestampGfx());
-    scene->addItem(line->getWhoGfx());
-    scene->addItem(line->getMessageGfx());
+void IrcBacklogView::endUpdate() {
+    if (updateDepth_ == 0 || --updateDepth_ > 0) return;
+    if (!layoutPending_) return;
 
-    if (bUpdateLayout)
-        updateLayout();
+    layoutPending_ = false;
+    updateLayout();
 
-    if (scrollToBottom)
-        this->ensureVisible(QRectF(0, this->scene()->sceneRect().height(), 0, 0));
+    size_t row;
+    if (scrollPending_) {
+        this->ensureVisible(QRectF(0, this->scene()->sceneRect().bottom(), 0, 0));
+    } else if (chatLines_.find(anchorId_, row)) {
+        // lines added above must not push the one being read away
+        QScrollBar* bar = this->verticalScrollBar();
+        qreal offset = chatLines_.lineTop(row) + anchorOffset_ - mapToScene(0, 0).y();
+        if (bar != nullptr && offset != 0)
+            bar->setValue(bar->value() + qRound(offset));
+    }
 }
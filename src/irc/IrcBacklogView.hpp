@@ -2,29 +2,64 @@
 #define IRCBACKLOGVIEW_H
 
 
-#include <list>
+#include <vector>
 #include <array>
+#include <memory>
 #include <QGraphicsView>
 #include <QMouseEvent>
 #include <QResizeEvent>
+#include <QTextDocument>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+#include <QShowEvent>
 
 #include "irc/IrcChatLine.hpp"
+#include "irc/IrcChatLineItem.hpp"
+#include "irc/IrcChatLineStore.hpp"
 #include "GraphicsHandle.hpp"
 
 
+// Only the rows inside the viewport (plus some overscan) get render items,
+// all other lines are plain data with a cached height in an IrcChatLineStore.
 class IrcBacklogView : public QGraphicsView {
     Q_OBJECT
 
     std::array<qreal, 3> splitting_;
-    std::list<IrcChatLine> chatLines_;
+    IrcChatLineStore chatLines_;
 
     std::array<GraphicsHandle, 2> handles;
 
+    QTextDocument measureDocument_; // measures lines that are not materialized
+    std::array<qreal, 3> measuredWidths_; // column widths the cached heights belong to
+    qreal timestampHeight_;
+    std::vector<std::unique_ptr<IrcChatLineItem>> items_; // every render item ever created
+    std::vector<IrcChatLineItem*> freeItems_;
+    QHash<size_t, IrcChatLineItem*> visibleItems_; // by line id
+    std::vector<IrcChatLineItem*> visibleUnnumbered_; // lines with id 0
+
+    int updateDepth_;
+    bool layoutPending_;
+    bool scrollPending_;
+    size_t anchorId_; // line at the top edge when an update began, 0 if none
+    qreal anchorOffset_;
+    std::vector<IrcChatLine> pendingLines_; // live lines waiting for the next frame
+    QSet<size_t> pendingIds_;
+    QTimer flushTimer_;
+
+    void columnWidths(qreal& timeWidth, qreal& whoWidth, qreal& messageWidth) const;
+    qreal measureText(const QString& text, qreal width, qreal& fit);
+    void measureLine(IrcChatLine& line);
+    void updateWidths();
     void updateLayout(bool moveHandle1 = true, bool moveHandle2 = true);
+    void updateVisibleRows();
+    void flushPendingLines();
 
 protected:
     virtual void resizeEvent(QResizeEvent* event) override;
     virtual void mousePressEvent(QMouseEvent* event) override;
+    virtual void scrollContentsBy(int dx, int dy) override;
+    virtual void showEvent(QShowEvent* event) override;
 
 public:
     explicit IrcBacklogView(QGraphicsScene* scene);
@@ -35,6 +70,13 @@ public:
                     const QString& message,
                     const MessageColor color = MessageColor::Default,
                     bool bUpdateLayout = true);
+    // one merge and one layout for a whole page
+    void addMessages(std::vector<IrcChatLine>&& lines);
+
+    // defer layout and scrolling until the outermost endUpdate, which keeps
+    // either the bottom or the line at the top edge in place
+    void beginUpdate();
+    void endUpdate();
 };
 
 
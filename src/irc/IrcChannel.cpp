@@ -17,9 +17,13 @@ IrcChannel::IrcChannel(const std::weak_ptr<IrcServer>& server,
     : TreeEntry('c')
     , backlogRequested_{false}
     , firstId_{std::numeric_limits<size_t>::max()}
+    , lastId_{std::numeric_limits<size_t>::max()}
     , server_{server}
     , name_{name}
     , disabled_{disabled}
+    , unreadCount_{0}
+    , highlightCount_{0}
+    , joinPartFilter_{0}
     , backlogCanvas_(&backlogScene_)
 {
     userTreeView_.setHeaderHidden(true);
@@ -56,6 +60,14 @@ size_t IrcChannel::getFirstId() const {
     return firstId_;
 }
 
+size_t IrcChannel::getLastId() const {
+    return lastId_;
+}
+
+void IrcChannel::resetBacklogRequest() {
+    backlogRequested_ = false; // a request in flight is lost with the connection
+}
+
 std::weak_ptr<IrcServer> IrcChannel::getServer() const {
     return server_;
 }
@@ -84,6 +96,47 @@ void IrcChannel::setDisabled(bool disabled) {
     }
 }
 
+int IrcChannel::getUnreadCount() const {
+    return unreadCount_;
+}
+
+int IrcChannel::getHighlightCount() const {
+    return highlightCount_;
+}
+
+void IrcChannel::setUnread(int unread, int highlights) {
+    if (unreadCount_ != unread || highlightCount_ != highlights) {
+        unreadCount_ = unread;
+        highlightCount_ = highlights;
+
+        if (auto s = server_.lock())
+            s->getChannelModel().channelDataChanged(this);
+    }
+}
+
+int IrcChannel::getJoinPartFilter() const {
+    return joinPartFilter_;
+}
+
+void IrcChannel::setJoinPartFilter(int minutes) {
+    joinPartFilter_ = minutes;
+}
+
+void IrcChannel::setSpoke(const QString& nick, double time) {
+    auto it = lastSpoke_.find(nick);
+    if (it == lastSpoke_.end())
+        lastSpoke_.insert(nick, time);
+    else if (time > it.value())
+        it.value() = time;
+}
+
+bool IrcChannel::hidesJoinPart(const QString& nick, double time) const {
+    if (joinPartFilter_ <= 0) return false;
+    auto it = lastSpoke_.find(nick);
+    if (it == lastSpoke_.end()) return true;
+    return it.value() > time || time - it.value() > joinPartFilter_ * 60000.0; // times are in ms
+}
+
 void IrcChannel::expandUserGroup(const QModelIndex& index) {
     userTreeView_.setExpanded(index, true);
 }
@@ -108,15 +161,31 @@ void IrcChannel::resetUsers(std::list<std::shared_ptr<IrcUser>>& users) {
     userTreeModel_.resetUsers(users);
 }
 
+void IrcChannel::updateUsers(std::list<std::shared_ptr<IrcUser>>& users) {
+    userTreeModel_.updateUsers(users);
+}
+
 IrcUser* IrcChannel::getUser(const QString& nick) {
     return userTreeModel_.getUser(nick);
 }
 
 void IrcChannel::setTopic(size_t id, double timestamp, const QString& nick, const QString& topic) {
     topic_ = topic;
+    if (lastId_ == std::numeric_limits<size_t>::max() || id > lastId_)
+        lastId_ = id;
     backlogCanvas_.addMessage(id, timestamp, "!", IrcUser::stripNick(nick) + " changed the topic to: " + topic, MessageColor::Event);
 }
 
 void IrcChannel::addMessage(size_t id, double timestamp, const QString& nick, const QString& message, MessageColor color) {
+    if (lastId_ == std::numeric_limits<size_t>::max() || id > lastId_)
+        lastId_ = id;
     backlogCanvas_.addMessage(id, timestamp, nick, message, color);
 }
+
+void IrcChannel::addMessages(std::vector<IrcChatLine>&& lines) {
+    for (auto& line : lines) {
+        if (lastId_ == std::numeric_limits<size_t>::max() || line.getId() > lastId_)
+            lastId_ = line.getId();
+    }
+    backlogCanvas_.addMessages(std::move(lines));
+}
@@ -8,7 +8,9 @@
 #include <QGraphicsView>
 #include <QGraphicsScene>
 #include <QFont>
+#include <QHash>
 #include <list>
+#include <vector>
 #include <memory>
 
 #include "irc/IrcBacklogView.hpp"
@@ -25,11 +27,16 @@ class IrcChannel : public TreeEntry {
     bool backlogRequested_;
 
     size_t firstId_;
+    size_t lastId_; // highest id seen, used to fill the gap after a reconnect
     std::weak_ptr<IrcServer> server_;
     QString name_;
     QString topic_;
     IrcUserTreeModel userTreeModel_;
     bool disabled_;
+    int unreadCount_; // reported by the bouncer while not subscribed
+    int highlightCount_;
+    int joinPartFilter_; // minutes a user stays exempt after speaking, 0 if not filtered
+    QHash<QString, double> lastSpoke_; // nick -> time of the latest message
     QTreeView userTreeView_;
     QGraphicsScene backlogScene_; // TODO: create own class + chat line class
     IrcBacklogView backlogCanvas_;
@@ -42,16 +49,28 @@ public:
 
     void onBacklogResponse(size_t firstId);
     size_t getFirstId() const;
+    size_t getLastId() const;
+    void resetBacklogRequest();
     std::weak_ptr<IrcServer> getServer() const;
     QString getName() const;
     QString getTopic() const;
     bool getDisabled() const;
     void setDisabled(bool disabled);
+    int getUnreadCount() const;
+    int getHighlightCount() const;
+    void setUnread(int unread, int highlights);
+    int getJoinPartFilter() const;
+    void setJoinPartFilter(int minutes);
+    void setSpoke(const QString& nick, double time);
+    // a filtered join, part or quit is only shown if the nick spoke shortly before
+    bool hidesJoinPart(const QString& nick, double time) const;
     void addUser(std::shared_ptr<IrcUser> user);
     void resetUsers(std::list<std::shared_ptr<IrcUser>>& users);
+    void updateUsers(std::list<std::shared_ptr<IrcUser>>& users);
     IrcUser* getUser(const QString& nick);
     void setTopic(size_t id, double timestamp, const QString& nick, const QString& topic);
     void addMessage(size_t id, double timestamp, const QString& nick, const QString& message, MessageColor color);
+    void addMessages(std::vector<IrcChatLine>&& lines);
     IrcBacklogView* getBacklogView();
     QTreeView* getUserTreeView();
     IrcUserTreeModel& getUserModel();
@@ -14,27 +14,13 @@ IrcChatLine::IrcChatLine(size_t id,
     , timestamp_{formatTimestamp(time)}
     , who_{who}
     , message_{message}
-    , timestampGfx_(timestamp_)
-    , whoGfx_(who)
-    , messageGfx_(message)
+    , color_{color}
+    , textHeight_{-1}
+    , whoFit_{0}
+    , messageFit_{0}
+    , height_{0}
+    , top_{0}
 {
-    switch (color) {
-    case MessageColor::Notice:
-        timestampGfx_.setDefaultTextColor(Qt::darkYellow);
-        whoGfx_.setDefaultTextColor(Qt::darkYellow);
-        messageGfx_.setDefaultTextColor(Qt::darkYellow);
-        break;
-    case MessageColor::Event:
-        timestampGfx_.setDefaultTextColor(Qt::darkMagenta);
-        whoGfx_.setDefaultTextColor(Qt::darkMagenta);
-        messageGfx_.setDefaultTextColor(Qt::darkMagenta);
-        break;
-    case MessageColor::Action:
-        timestampGfx_.setDefaultTextColor(Qt::darkBlue);
-        whoGfx_.setDefaultTextColor(Qt::darkBlue);
-        messageGfx_.setDefaultTextColor(Qt::darkBlue);
-        break;
-    }
 }
 
 QString IrcChatLine::formatTimestamp(double timestamp) {
@@ -73,14 +59,37 @@ const QString& IrcChatLine::getMessageRef() const {
     return message_;
 }
 
-QGraphicsTextItem* IrcChatLine::getTimestampGfx() {
-    return &timestampGfx_;
+MessageColor IrcChatLine::getColor() const {
+    return color_;
 }
 
-QGraphicsTextItem* IrcChatLine::getWhoGfx() {
-    return &whoGfx_;
+qreal IrcChatLine::getTextHeight() const {
+    return textHeight_;
 }
 
-QGraphicsTextItem* IrcChatLine::getMessageGfx() {
-    return &messageGfx_;
+void IrcChatLine::setMeasure(qreal textHeight, qreal whoFit, qreal messageFit) {
+    textHeight_ = textHeight;
+    whoFit_ = whoFit;
+    messageFit_ = messageFit;
+}
+
+bool IrcChatLine::fits(qreal whoWidth, qreal messageWidth) const {
+    // one line stays one line as long as it fits, its height doesn't change
+    return whoFit_ <= whoWidth && messageFit_ <= messageWidth;
+}
+
+qreal IrcChatLine::getHeight() const {
+    return height_;
+}
+
+void IrcChatLine::setHeight(qreal height) {
+    height_ = height;
+}
+
+qreal IrcChatLine::getTop() const {
+    return top_;
+}
+
+void IrcChatLine::setTop(qreal top) {
+    top_ = top;
 }
@@ -3,7 +3,6 @@
 
 
 #include <QString>
-#include <QGraphicsTextItem>
 
 
 enum class MessageColor {
@@ -13,15 +12,19 @@ enum class MessageColor {
     Action
 };
 
+// plain line data, rendered by IrcChatLineItem while it is visible
 class IrcChatLine {
     size_t id_;
     double time_;
     QString timestamp_;
     QString who_;
     QString message_;
-    QGraphicsTextItem timestampGfx_;
-    QGraphicsTextItem whoGfx_;
-    QGraphicsTextItem messageGfx_;
+    MessageColor color_;
+    qreal textHeight_; // nick and message, negative until measured
+    qreal whoFit_; // widths that keep the columns on one line, infinite if wrapped
+    qreal messageFit_;
+    qreal height_;
+    qreal top_; // offset inside its block of the line store
 
     static QString formatTimestamp(double timestamp);
 
@@ -40,9 +43,14 @@ public:
     const QString& getTimestampRef() const;
     const QString& getWhoRef() const;
     const QString& getMessageRef() const;
-    QGraphicsTextItem* getTimestampGfx();
-    QGraphicsTextItem* getWhoGfx();
-    QGraphicsTextItem* getMessageGfx();
+    MessageColor getColor() const;
+    qreal getTextHeight() const;
+    void setMeasure(qreal textHeight, qreal whoFit, qreal messageFit);
+    bool fits(qreal whoWidth, qreal messageWidth) const;
+    qreal getHeight() const;
+    void setHeight(qreal height);
+    qreal getTop() const;
+    void setTop(qreal top);
 };
 
 
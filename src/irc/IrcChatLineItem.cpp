@@ -0,0 +1,56 @@
+#include "IrcChatLineItem.hpp"
+
+#include <QTextDocument>
+#include <QTextOption>
+
+
+IrcChatLineItem::IrcChatLineItem(QGraphicsScene* scene)
+    : defaultColor_{messageGfx_.defaultTextColor()}
+{
+    // nick col: align right, survives setPlainText
+    whoGfx_.document()->setDefaultTextOption(QTextOption(Qt::AlignRight));
+
+    scene->addItem(&timestampGfx_);
+    scene->addItem(&whoGfx_);
+    scene->addItem(&messageGfx_);
+}
+
+void IrcChatLineItem::setLine(const IrcChatLine& line) {
+    timestampGfx_.setPlainText(line.getTimestampRef());
+    whoGfx_.setPlainText(line.getWhoRef());
+    messageGfx_.setPlainText(line.getMessageRef());
+
+    QColor color = defaultColor_;
+    switch (line.getColor()) {
+    case MessageColor::Notice:
+        color = Qt::darkYellow;
+        break;
+    case MessageColor::Event:
+        color = Qt::darkMagenta;
+        break;
+    case MessageColor::Action:
+        color = Qt::darkBlue;
+        break;
+    case MessageColor::Default:
+        break;
+    }
+    timestampGfx_.setDefaultTextColor(color);
+    whoGfx_.setDefaultTextColor(color);
+    messageGfx_.setDefaultTextColor(color);
+}
+
+void IrcChatLineItem::setGeometry(qreal top, qreal timeWidth, qreal whoWidth, qreal messageWidth) {
+    timestampGfx_.setTextWidth(timeWidth);
+    whoGfx_.setTextWidth(whoWidth);
+    messageGfx_.setTextWidth(messageWidth);
+
+    timestampGfx_.setPos(0, top);
+    whoGfx_.setPos(timeWidth, top);
+    messageGfx_.setPos(timeWidth + whoWidth, top);
+}
+
+void IrcChatLineItem::setVisible(bool visible) {
+    timestampGfx_.setVisible(visible);
+    whoGfx_.setVisible(visible);
+    messageGfx_.setVisible(visible);
+}
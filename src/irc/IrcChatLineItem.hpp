@@ -0,0 +1,29 @@
+#ifndef IRCCHATLINEITEM_H
+#define IRCCHATLINEITEM_H
+
+
+#include <QGraphicsTextItem>
+#include <QGraphicsScene>
+#include <QColor>
+
+#include "irc/IrcChatLine.hpp"
+
+
+// Render objects for one visible row. The backlog view keeps a small pool
+// of these and points them at whichever lines are inside the viewport.
+class IrcChatLineItem {
+    QGraphicsTextItem timestampGfx_;
+    QGraphicsTextItem whoGfx_;
+    QGraphicsTextItem messageGfx_;
+    QColor defaultColor_;
+
+public:
+    explicit IrcChatLineItem(QGraphicsScene* scene);
+
+    void setLine(const IrcChatLine& line);
+    void setGeometry(qreal top, qreal timeWidth, qreal whoWidth, qreal messageWidth);
+    void setVisible(bool visible);
+};
+
+
+#endif
@@ -0,0 +1,282 @@
+#include "IrcChatLineStore.hpp"
+
+#include <algorithm>
+
+
+// a full block at either end gets a new neighbour, inner blocks are split
+static const size_t blockSize = 256;
+
+
+IrcChatLineStore::IrcChatLineStore()
+    : size_{0}
+{
+}
+
+size_t IrcChatLineStore::size() const {
+    return size_;
+}
+
+bool IrcChatLineStore::empty() const {
+    return size_ == 0;
+}
+
+bool IrcChatLineStore::contains(size_t id) const {
+    return ids_.contains(id);
+}
+
+size_t IrcChatLineStore::blockOfRow(size_t row) const {
+    auto it = std::upper_bound(blocks_.begin(), blocks_.end(), row, [](size_t row, const Block& block) {
+            return row < block.firstRow;
+        });
+    return it == blocks_.begin() ? 0 : (it - blocks_.begin()) - 1;
+}
+
+size_t IrcChatLineStore::blockOfId(size_t id) const {
+    // first block that ends at or after id
+    auto it = std::lower_bound(blocks_.begin(), blocks_.end(), id, [](const Block& block, size_t id) {
+            return block.lines.back().getId() < id;
+        });
+    return it == blocks_.end() ? blocks_.size() - 1 : it - blocks_.begin();
+}
+
+void IrcChatLineStore::layoutBlock(Block& block) {
+    qreal top = 0;
+    for (auto& line : block.lines) {
+        line.setTop(top);
+        top += line.getHeight();
+    }
+    block.height = top;
+}
+
+void IrcChatLineStore::splitBlock(size_t block) {
+    Block& full = blocks_[block];
+    size_t half = full.lines.size() / 2;
+
+    Block second;
+    second.lines.assign(std::make_move_iterator(full.lines.begin() + half),
+                        std::make_move_iterator(full.lines.end()));
+    second.firstRow = full.firstRow + half;
+    second.top = full.top + second.lines.front().getTop();
+    full.lines.erase(full.lines.begin() + half, full.lines.end());
+    layoutBlock(full);
+    layoutBlock(second);
+    blocks_.insert(blocks_.begin() + block + 1, std::move(second));
+}
+
+void IrcChatLineStore::shiftBlocks(size_t first, qreal offset) {
+    for (size_t i = first; i < blocks_.size(); ++i) {
+        blocks_[i].firstRow += 1;
+        blocks_[i].top += offset;
+    }
+}
+
+size_t IrcChatLineStore::insert(IrcChatLine&& line) {
+    size_t id = line.getId();
+    qreal height = line.getHeight();
+    if (id != 0)
+        ids_.insert(id);
+    size_ += 1;
+
+    if (blocks_.empty()) {
+        Block block;
+        block.firstRow = 0;
+        block.top = 0;
+        block.height = height;
+        line.setTop(0);
+        block.lines.push_back(std::move(line));
+        blocks_.push_back(std::move(block));
+        return 0;
+    }
+
+    // id 0 is not unique and always goes to the end
+    if (id == 0 || id > blocks_.back().lines.back().getId()) {
+        if (blocks_.back().lines.size() >= blockSize) {
+            Block block;
+            block.firstRow = size_ - 1;
+            block.top = blocks_.back().top + blocks_.back().height;
+            block.height = 0;
+            blocks_.push_back(std::move(block));
+        }
+        Block& block = blocks_.back();
+        line.setTop(block.height);
+        block.height += height;
+        block.lines.push_back(std::move(line));
+        return size_ - 1;
+    }
+
+    if (id < blocks_.front().lines.front().getId()) {
+        // grows upwards, nothing below moves
+        if (blocks_.front().lines.size() >= blockSize) {
+            Block block;
+            block.firstRow = 0;
+            block.top = blocks_.front().top;
+            block.height = 0;
+            blocks_.push_front(std::move(block));
+        }
+        Block& block = blocks_.front();
+        block.lines.insert(block.lines.begin(), std::move(line));
+        block.top -= height;
+        layoutBlock(block);
+        for (size_t i = 1; i < blocks_.size(); ++i)
+            blocks_[i].firstRow += 1;
+        return 0;
+    }
+
+    size_t blockIndex = blockOfId(id);
+    Block& block = blocks_[blockIndex];
+    auto position = std::lower_bound(block.lines.begin(), block.lines.end(), id, [](const IrcChatLine& line, size_t id) {
+            return line.getId() < id;
+        });
+    size_t row = block.firstRow + (position - block.lines.begin());
+    block.lines.insert(position, std::move(line));
+    layoutBlock(block);
+    shiftBlocks(blockIndex + 1, height);
+    if (block.lines.size() > 2 * blockSize)
+        splitBlock(blockIndex);
+    return row;
+}
+
+// blocks of lines[first, last), the first one starting at firstRow
+std::vector<IrcChatLineStore::Block> IrcChatLineStore::makeBlocks(std::vector<IrcChatLine>& lines, size_t first, size_t last, size_t firstRow, qreal top) {
+    std::vector<Block> blocks;
+    blocks.reserve((last - first + blockSize - 1) / blockSize);
+    for (size_t start = first; start < last; start += blockSize) {
+        size_t end = std::min(last, start + blockSize);
+        Block block;
+        block.lines.assign(std::make_move_iterator(lines.begin() + start),
+                           std::make_move_iterator(lines.begin() + end));
+        block.firstRow = firstRow + (start - first);
+        block.top = top;
+        layoutBlock(block);
+        top += block.height;
+        blocks.push_back(std::move(block));
+    }
+    return blocks;
+}
+
+void IrcChatLineStore::insert(std::vector<IrcChatLine>&& lines) {
+    // duplicates within the page and of stored lines are dropped
+    QSet<size_t> pageIds;
+    lines.erase(std::remove_if(lines.begin(), lines.end(), [this, &pageIds](const IrcChatLine& line) {
+                size_t id = line.getId();
+                if (id == 0) return false;
+                if (ids_.contains(id) || pageIds.contains(id)) return true;
+                pageIds.insert(id);
+                return false;
+            }), lines.end());
+    if (lines.empty()) return;
+
+    bool ordered = lines.front().getId() != 0;
+    if (ordered && (blocks_.empty() || lines.front().getId() > blocks_.back().lines.back().getId())) {
+        for (auto& line : lines)
+            ids_.insert(line.getId());
+        // the last block is filled up first, small pages must not leave small blocks
+        size_t taken = 0;
+        if (!blocks_.empty()) {
+            Block& last = blocks_.back();
+            taken = std::min(lines.size(), blockSize - std::min(blockSize, last.lines.size()));
+            for (size_t i = 0; i < taken; ++i) {
+                lines[i].setTop(last.height);
+                last.height += lines[i].getHeight();
+                last.lines.push_back(std::move(lines[i]));
+            }
+            size_ += taken;
+        }
+        std::vector<Block> blocks = makeBlocks(lines, taken, lines.size(), size_, bottom());
+        size_ += lines.size() - taken;
+        for (auto& block : blocks)
+            blocks_.push_back(std::move(block));
+    } else if (ordered && lines.back().getId() < blocks_.front().lines.front().getId()) {
+        // older history, grows upwards so nothing stored moves
+        for (auto& line : lines)
+            ids_.insert(line.getId());
+        for (auto& block : blocks_)
+            block.firstRow += lines.size();
+        size_ += lines.size();
+
+        // the newest lines of the page fill up the first block
+        Block& first = blocks_.front();
+        size_t taken = std::min(lines.size(), blockSize - std::min(blockSize, first.lines.size()));
+        size_t rest = lines.size() - taken;
+        if (taken > 0) {
+            qreal takenHeight = 0;
+            for (size_t i = rest; i < lines.size(); ++i)
+                takenHeight += lines[i].getHeight();
+            first.lines.insert(first.lines.begin(), std::make_move_iterator(lines.begin() + rest),
+                               std::make_move_iterator(lines.end()));
+            first.firstRow -= taken;
+            first.top -= takenHeight;
+            layoutBlock(first);
+        }
+
+        qreal height = 0;
+        for (size_t i = 0; i < rest; ++i)
+            height += lines[i].getHeight();
+        std::vector<Block> blocks = makeBlocks(lines, 0, rest, 0, top() - height);
+        blocks_.insert(blocks_.begin(), std::make_move_iterator(blocks.begin()), std::make_move_iterator(blocks.end()));
+    } else {
+        // overlaps stored lines, e.g. a gap being filled
+        for (auto& line : lines)
+            insert(std::move(line));
+    }
+}
+
+bool IrcChatLineStore::find(size_t id, size_t& row) const {
+    if (id == 0 || !ids_.contains(id)) return false;
+
+    const Block& block = blocks_[blockOfId(id)];
+    auto it = std::lower_bound(block.lines.begin(), block.lines.end(), id, [](const IrcChatLine& line, size_t id) {
+            return line.getId() < id;
+        });
+    if (it == block.lines.end() || it->getId() != id) return false;
+    row = block.firstRow + (it - block.lines.begin());
+    return true;
+}
+
+IrcChatLine& IrcChatLineStore::at(size_t row) {
+    Block& block = blocks_[blockOfRow(row)];
+    return block.lines[row - block.firstRow];
+}
+
+const IrcChatLine& IrcChatLineStore::at(size_t row) const {
+    const Block& block = blocks_[blockOfRow(row)];
+    return block.lines[row - block.firstRow];
+}
+
+qreal IrcChatLineStore::lineTop(size_t row) const {
+    const Block& block = blocks_[blockOfRow(row)];
+    return block.top + block.lines[row - block.firstRow].getTop();
+}
+
+size_t IrcChatLineStore::rowAt(qreal y) const {
+    if (blocks_.empty()) return 0;
+
+    auto blockIt = std::upper_bound(blocks_.begin(), blocks_.end(), y, [](qreal y, const Block& block) {
+            return y < block.top;
+        });
+    const Block& block = blockIt == blocks_.begin() ? blocks_.front() : *(blockIt - 1);
+
+    qreal localY = y - block.top;
+    auto lineIt = std::upper_bound(block.lines.begin(), block.lines.end(), localY, [](qreal y, const IrcChatLine& line) {
+            return y < line.getTop();
+        });
+    size_t index = lineIt == block.lines.begin() ? 0 : (lineIt - block.lines.begin()) - 1;
+    return std::min(block.firstRow + index, size_ - 1);
+}
+
+qreal IrcChatLineStore::top() const {
+    return blocks_.empty() ? 0 : blocks_.front().top;
+}
+
+qreal IrcChatLineStore::bottom() const {
+    return blocks_.empty() ? 0 : blocks_.back().top + blocks_.back().height;
+}
+
+void IrcChatLineStore::updateTops() {
+    qreal top = this->top();
+    for (auto& block : blocks_) {
+        block.top = top;
+        layoutBlock(block);
+        top += block.height;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef IRCCHATLINESTORE_H
+#define IRCCHATLINESTORE_H
+
+
+#include <deque>
+#include <vector>
+#include <cstddef>
+#include <QSet>
+
+#include "irc/IrcChatLine.hpp"
+
+
+// Chat lines sorted by id, kept in blocks of a few hundred lines. Rows are
+// looked up by index or by vertical position with binary searches over the
+// blocks, an insert only moves lines inside one block. Line tops are stored
+// relative to their block, so blocks below an insert just shift.
+class IrcChatLineStore {
+    struct Block {
+        std::vector<IrcChatLine> lines;
+        size_t firstRow;
+        qreal top;
+        qreal height;
+    };
+
+    std::deque<Block> blocks_;
+    QSet<size_t> ids_;
+    size_t size_;
+
+    size_t blockOfRow(size_t row) const;
+    size_t blockOfId(size_t id) const;
+    void layoutBlock(Block& block);
+    void splitBlock(size_t block);
+    void shiftBlocks(size_t first, qreal offset);
+    std::vector<Block> makeBlocks(std::vector<IrcChatLine>& lines, size_t first, size_t last, size_t firstRow, qreal top);
+
+public:
+    IrcChatLineStore();
+
+    size_t size() const;
+    bool empty() const;
+    bool contains(size_t id) const;
+
+    // the line must be measured already, lines above it keep their position
+    size_t insert(IrcChatLine&& line);
+    // measured lines sorted by id, a page before or after all stored lines
+    // tops up the end block and becomes new blocks in one pass
+    void insert(std::vector<IrcChatLine>&& lines);
+    bool find(size_t id, size_t& row) const;
+
+    IrcChatLine& at(size_t row);
+    const IrcChatLine& at(size_t row) const;
+    qreal lineTop(size_t row) const;
+    size_t rowAt(qreal y) const; // row containing y, clamped to the stored rows
+    qreal top() const;
+    qreal bottom() const;
+
+    // recomputes all positions after line heights changed, keeps the top edge
+    void updateTops();
+
+    template <typename Function>
+    void forEachLine(Function function) {
+        for (auto& block : blocks_) {
+            for (auto& line : block.lines)
+                function(line);
+        }
+    }
+};
+
+
+#endif
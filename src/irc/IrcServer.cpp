@@ -6,12 +6,15 @@
 IrcServer::IrcServer(const QString& activeNick,
                const QString& id,
                const QString& name,
-               bool disabled)
+               bool disabled,
+               int core)
     : TreeEntry('s')
     , id_{id}
     , name_{name}
     , nick_{activeNick}
     , disabled_{disabled}
+    , core_{core}
+    , stale_{false}
 {
 }
 
@@ -35,6 +38,10 @@ QString IrcServer::getName() const {
     return name_;
 }
 
+void IrcServer::setName(const QString& name) {
+    name_ = name;
+}
+
 QString IrcServer::getActiveNick() const {
     return nick_;
 }
@@ -43,6 +50,18 @@ void IrcServer::setActiveNick(const QString& nick) {
     nick_ = nick;
 }
 
+int IrcServer::getCore() const {
+    return core_;
+}
+
+bool IrcServer::getStale() const {
+    return stale_;
+}
+
+void IrcServer::setStale(bool stale) {
+    stale_ = stale;
+}
+
 IrcChannel* IrcServer::getBacklog() {
     if (!backlog_)
         backlog_ = std::make_shared<IrcChannel>(std::static_pointer_cast<IrcServer>(shared_from_this()), "["+name_+"]", false);
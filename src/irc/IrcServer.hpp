@@ -23,21 +23,28 @@ class IrcServer : public TreeEntry {
     QString name_;
     QString nick_;
     bool disabled_;
+    int core_; // the bouncer core this server lives on
+    bool stale_;
     std::shared_ptr<IrcChannel> backlog_;
 
 public:
     IrcServer(const QString& activeNick,
            const QString& id,
            const QString& name,
-           bool disabled);
+           bool disabled,
+           int core);
 
     IrcChannelTreeModel& getChannelModel();
     IrcHostTreeModel& getHostModel();
     IrcNickModel& getNickModel();
     QString getId() const;
     QString getName() const;
+    void setName(const QString& name);
     QString getActiveNick() const;
     void setActiveNick(const QString& nick);
+    int getCore() const;
+    bool getStale() const;
+    void setStale(bool stale);
     IrcChannel* getBacklog();
 };
 
@@ -1,6 +1,8 @@
 #include "SettingsTypeModel.hpp"
 #include "moc_SettingsTypeModel.cpp"
 
+#include <algorithm>
+
 
 SettingsTypeModel::SettingsTypeModel(QObject* parent)
     : QAbstractItemModel(parent)
@@ -71,6 +73,10 @@ QVariant SettingsTypeModel::headerData(int section, Qt::Orientation orientation,
     return QVariant();
 }
 
+bool SettingsTypeModel::hasType(const QString& name) const {
+    return std::find(typeNames_.begin(), typeNames_.end(), name) != typeNames_.end();
+}
+
 void SettingsTypeModel::newType(const QString& name) {
     int rowIndex = 0;
     beginInsertRows(QModelIndex{}, rowIndex, rowIndex);
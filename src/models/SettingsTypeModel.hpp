@@ -24,6 +24,7 @@ public:
     int rowCount(const QModelIndex& parent = QModelIndex()) const Q_DECL_OVERRIDE;
     int columnCount(const QModelIndex& parent = QModelIndex()) const Q_DECL_OVERRIDE;
 
+    bool hasType(const QString& name) const;
     void newType(const QString& name);
     void resetTypes(const std::list<QString>& types);
 };
@@ -171,7 +171,7 @@ void IrcChannelTreeModel::deleteChannel(const QString& channelName) {
             break;
     }
     if (it == channels_.end()) return;
-    beginRemoveRows(QModelIndex{}, rowIndex, rowIndex+1);
+    beginRemoveRows(QModelIndex{}, rowIndex, rowIndex);
     auto server = (*it)->getServer().lock();
     emit beginRemoveChannel(server, rowIndex);
     channels_.erase(it);
@@ -4,6 +4,8 @@
 #include "irc/IrcChannel.hpp"
 
 #include <QIcon>
+#include <QColor>
+#include <QFont>
 
 
 IrcServerTreeModel::IrcServerTreeModel(QObject* parent)
@@ -81,6 +83,9 @@ QVariant IrcServerTreeModel::data(const QModelIndex& index, int role) const {
     if (item->getTreeEntryType() == 's') {
         IrcServer* server = static_cast<IrcServer*>(index.internalPointer());
 
+        if (role == Qt::ForegroundRole)
+            return server->getStale() ? QVariant(QColor(Qt::gray)) : QVariant();
+
         if (role == Qt::DecorationRole)
             return QVariant();
 
@@ -91,12 +96,27 @@ QVariant IrcServerTreeModel::data(const QModelIndex& index, int role) const {
     } else {
         IrcChannel* channel = static_cast<IrcChannel*>(index.internalPointer());
 
+        if (role == Qt::ForegroundRole) {
+            auto server = channel->getServer().lock();
+            return server && server->getStale() ? QVariant(QColor(Qt::gray)) : QVariant();
+        }
+
         if (role == Qt::DecorationRole)
             return QIcon(channel->getDisabled() ? ":icons/channelDisabled.png" : ":icons/channel.png");
 
+        if (role == Qt::FontRole) {
+            if (channel->getHighlightCount() == 0)
+                return QVariant();
+            QFont font;
+            font.setBold(true);
+            return font;
+        }
+
         if (role != Qt::DisplayRole)
             return QVariant();
 
+        if (channel->getUnreadCount() > 0)
+            return channel->getName() + " (" + QString::number(channel->getUnreadCount()) + ")";
         return channel->getName();
     }
 
@@ -122,9 +142,10 @@ std::list<std::shared_ptr<IrcServer>>& IrcServerTreeModel::getServers() {
     return servers_;
 }
 
-std::shared_ptr<IrcServer> IrcServerTreeModel::getServer(const QString& serverId) {
-    auto it = find_if(servers_.begin(), servers_.end(), [&serverId](std::shared_ptr<IrcServer> server){
-            return server->getId() == serverId;
+std::shared_ptr<IrcServer> IrcServerTreeModel::getServer(int core, const QString& serverId) {
+    // server ids are only unique within one core
+    auto it = find_if(servers_.begin(), servers_.end(), [core, &serverId](std::shared_ptr<IrcServer> server){
+            return server->getCore() == core && server->getId() == serverId;
         });
     if (it == servers_.end()) return nullptr;
     return *it;
@@ -140,6 +161,31 @@ int IrcServerTreeModel::getServerIndex(IrcServer* server) {
     return -1;
 }
 
+void IrcServerTreeModel::setStale(int core, bool stale) {
+    // repaint the rows of this core, the views are kept as they are
+    int rowIndex = 0;
+    for (auto& server : servers_) {
+        if (server->getCore() != core || server->getStale() == stale) {
+            rowIndex += 1;
+            continue;
+        }
+        server->setStale(stale);
+        auto serverIndex = createIndex(rowIndex, 0, server.get());
+        emit dataChanged(serverIndex, serverIndex);
+        int channelCount = server->getChannelModel().rowCount();
+        if (channelCount > 0)
+            emit dataChanged(index(0, 0, serverIndex), index(channelCount-1, 0, serverIndex));
+        rowIndex += 1;
+    }
+}
+
+void IrcServerTreeModel::serverDataChanged(IrcServer* server) {
+    auto rowIndex = getServerIndex(server);
+    if (rowIndex < 0) return;
+    auto modelIndex = createIndex(rowIndex, 0, server);
+    emit dataChanged(modelIndex, modelIndex);
+}
+
 void IrcServerTreeModel::connectServer(IrcServer* server) {
     IrcChannelTreeModel& channelTreeModel = server->getChannelModel();
     connect(&channelTreeModel, &IrcChannelTreeModel::beginInsertChannel, [this](std::shared_ptr<IrcServer> server, int where) {
@@ -190,17 +236,19 @@ void IrcServerTreeModel::newServer(std::shared_ptr<IrcServer> server) {
 
     servers_.push_back(server);
     endInsertRows();
+
+    emit expand(createIndex(rowIndex, 0, server.get()));
 }
 
-void IrcServerTreeModel::deleteServer(const QString& serverId) {
+void IrcServerTreeModel::deleteServer(int core, const QString& serverId) {
     int rowIndex = 0;
     decltype(servers_)::iterator it;
     for (it = servers_.begin(); it != servers_.end(); ++it, ++rowIndex) {
-        if ((*it)->getId() == serverId)
+        if ((*it)->getCore() == core && (*it)->getId() == serverId)
             break;
     }
     if (it == servers_.end()) return;
-    beginRemoveRows(QModelIndex{}, rowIndex, rowIndex+1);
+    beginRemoveRows(QModelIndex{}, rowIndex, rowIndex);
     servers_.erase(it);
     endRemoveRows();
 }
@@ -26,10 +26,12 @@ public:
     int columnCount(const QModelIndex& parent = QModelIndex()) const Q_DECL_OVERRIDE;
 
     std::list<std::shared_ptr<IrcServer>>& getServers();
-    std::shared_ptr<IrcServer> getServer(const QString& serverId);
+    std::shared_ptr<IrcServer> getServer(int core, const QString& serverId);
     int getServerIndex(IrcServer* server);
     void connectServer(IrcServer* server);
     void reconnectEvents();
+    void setStale(int core, bool stale);
+    void serverDataChanged(IrcServer* server);
 
 signals:
     void expand(const QModelIndex& index);
@@ -38,7 +40,7 @@ signals:
 public Q_SLOTS:
     void resetServers(std::list<std::shared_ptr<IrcServer>>& servers);
     void newServer(std::shared_ptr<IrcServer> server);
-    void deleteServer(const QString& serverId);
+    void deleteServer(int core, const QString& serverId);
 
 private:
     std::list<std::shared_ptr<IrcServer>> servers_;
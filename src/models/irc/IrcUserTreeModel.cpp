@@ -3,6 +3,9 @@
 #include "irc/IrcUser.hpp"
 #include "irc/IrcUserGroup.hpp"
 
+#include <QHash>
+#include <QStringList>
+
 
 IrcUserTreeModel::IrcUserTreeModel(QObject* parent)
     : QAbstractItemModel(parent)
@@ -219,7 +222,7 @@ void IrcUserTreeModel::addUser(std::shared_ptr<IrcUser> user) {
             return;
     }
 
-    auto idx = getUserGroupIndex(groupUsers_.get());
+    auto idx = getUserGroupIndex(userGroup);
     auto rowIndex = userGroup->getUserCount();
     beginInsertRows(index(idx, 0), rowIndex, rowIndex);
     users_.push_back(user);
@@ -273,6 +276,7 @@ bool IrcUserTreeModel::changeMode(const QString& nick,
     removeUser(nick);
     user->setUserGroup(getGroup(modeName(user->getAccessMode())));
     addUser(user);
+    return true;
 }
 
 bool IrcUserTreeModel::renameUser(const QString& nick,
@@ -289,3 +293,43 @@ bool IrcUserTreeModel::renameUser(const QString& nick,
 
     return true;
 }
+
+void IrcUserTreeModel::updateUsers(std::list<std::shared_ptr<IrcUser>>& users) {
+    // apply only the differences, keeps expansion and selection
+    if (groups_.empty()) {
+        resetUsers(users);
+        return;
+    }
+
+    QHash<QString, std::shared_ptr<IrcUser>> newUsers;
+    for (auto& u : users)
+        newUsers.insert(u->getNick(), u);
+
+    QStringList removed;
+    for (auto& u : users_) {
+        if (!newUsers.contains(u->getNick()))
+            removed.append(u->getNick());
+    }
+    for (auto& nick : removed)
+        removeUser(nick);
+
+    for (auto& u : users) {
+        IrcUser* user = getUser(u->getNick());
+        if (!user) {
+            u->setUserGroup(getGroup(modeName(u->getAccessMode())));
+            addUser(u);
+            continue;
+        }
+
+        QString oldMode = user->getMode();
+        QString newMode = u->getMode();
+        for (QChar modeChar : oldMode) {
+            if (!newMode.contains(modeChar))
+                changeMode(u->getNick(), modeChar.toLatin1(), false);
+        }
+        for (QChar modeChar : newMode) {
+            if (!oldMode.contains(modeChar))
+                changeMode(u->getNick(), modeChar.toLatin1(), true);
+        }
+    }
+}
@@ -45,6 +45,7 @@ signals:
 
 public Q_SLOTS:
     void resetUsers(std::list<std::shared_ptr<IrcUser>>& users);
+    void updateUsers(std::list<std::shared_ptr<IrcUser>>& users);
 
 private:
     std::shared_ptr<IrcUserGroup> groupUsers_;
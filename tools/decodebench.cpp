@@ -0,0 +1,144 @@
+// Decodes recorded frames repeatedly and reports the throughput of the json
+// parser alone and of parser plus decoder, and the per-frame cost of command
+// dispatch: the table lookup against the if/else chain it replaced.
+// Input is one json frame per line, as logged with
+// QT_LOGGING_RULES="harpoon.frames.debug=true".
+//
+//   decodebench <frames.jsonl> [rounds]
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <vector>
+#include <utility>
+
+#include "HarpoonDecoder.hpp"
+
+
+// the dispatch before the command table, same indices as findCommand()
+static int findCommandIfElse(const QString& protocol, const QString& cmd) {
+    if (protocol.isEmpty()) {
+        if (cmd == "login") return 0;
+        else if (cmd == "batch") return 1;
+    } else if (protocol == "irc") {
+        if (cmd == "chatlist") return 2;
+        else if (cmd == "chat") return 3;
+        else if (cmd == "userlist") return 4;
+        else if (cmd == "nickchange") return 5;
+        else if (cmd == "nickmodified") return 6;
+        else if (cmd == "serveradded") return 7;
+        else if (cmd == "serverremoved") return 8;
+        else if (cmd == "hostadded") return 9;
+        else if (cmd == "hostdeleted") return 10;
+        else if (cmd == "topic") return 11;
+        else if (cmd == "action") return 12;
+        else if (cmd == "mode") return 13;
+        else if (cmd == "kick") return 14;
+        else if (cmd == "notice") return 15;
+        else if (cmd == "join") return 16;
+        else if (cmd == "part") return 17;
+        else if (cmd == "settings") return 18;
+        else if (cmd == "quit") return 19;
+        else if (cmd == "backlogresponse") return 20;
+        else if (cmd == "unread") return 21;
+        else if (cmd == "members") return 22;
+    }
+    return -1;
+}
+
+template <typename Find>
+static void runDispatch(const char* name, const std::vector<std::pair<QString, QString>>& commands, int rounds, Find find) {
+    QTextStream out(stdout);
+    qint64 found = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int round = 0; round < rounds; ++round) {
+        for (auto& command : commands)
+            found += find(command.first, command.second) >= 0 ? 1 : 0;
+    }
+    double count = static_cast<double>(commands.size()) * rounds;
+    out << name << ": " << found << "/" << static_cast<qint64>(count) << " commands found, "
+        << (timer.nsecsElapsed() / count) << " ns/frame\n";
+    out.flush();
+}
+
+
+template <typename Decode>
+static void run(const char* name, const std::vector<QByteArray>& frames, qint64 bytes, int rounds, Decode decode) {
+    QTextStream out(stdout);
+    size_t decoded = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int round = 0; round < rounds; ++round) {
+        HarpoonDecoder decoder; // every round is a fresh session
+        for (const QByteArray& frame : frames)
+            decoded += decode(decoder, frame) ? 1 : 0;
+    }
+    double seconds = timer.nsecsElapsed() / 1e9;
+    double count = static_cast<double>(frames.size()) * rounds;
+    out << name << ": " << decoded << "/" << static_cast<qint64>(count) << " frames decoded, "
+        << static_cast<qint64>(count / seconds) << " frames/s, "
+        << (bytes * static_cast<double>(rounds) / seconds / (1024 * 1024)) << " MB/s\n";
+    out.flush();
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+    if (args.size() < 2) {
+        QTextStream(stderr) << "usage: decodebench <frames.jsonl> [rounds]\n";
+        return 1;
+    }
+
+    QFile file(args[1]);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QTextStream(stderr) << "cannot open " << args[1] << "\n";
+        return 1;
+    }
+    std::vector<QByteArray> frames;
+    qint64 bytes = 0;
+    while (!file.atEnd()) {
+        QByteArray line = file.readLine().trimmed();
+        if (line.isEmpty()) continue;
+        bytes += line.size();
+        frames.push_back(line);
+    }
+    int rounds = args.size() > 2 ? args[2].toInt() : 100;
+    if (rounds <= 0) rounds = 1;
+
+    // dispatch alone, on the names of the recorded frames; interned commands
+    // need the session dictionary and are left out
+    std::vector<std::pair<QString, QString>> commands;
+    for (const QByteArray& frame : frames) {
+        QJsonObject root = QJsonDocument::fromJson(frame).object();
+        QJsonValue cmd = root.value(QLatin1String("cmd"));
+        if (cmd.isString())
+            commands.emplace_back(root.value(QLatin1String("protocol")).toString(), cmd.toString());
+    }
+    runDispatch("if/else dispatch", commands, rounds * 10, findCommandIfElse);
+    runDispatch("table dispatch", commands, rounds * 10, HarpoonDecoder::findCommand);
+
+    run("qtjson parse", frames, bytes, rounds, [](HarpoonDecoder&, const QByteArray& frame) {
+        return QJsonDocument::fromJson(frame).isObject();
+    });
+    run("qtjson decode", frames, bytes, rounds, [](HarpoonDecoder& decoder, const QByteArray& frame) {
+        QJsonDocument doc = QJsonDocument::fromJson(frame);
+        return decoder.decode(doc.object()) != nullptr;
+    });
+
+#ifdef HARPOON_SIMDJSON
+    simdjson::dom::parser parser;
+    run("simdjson parse", frames, bytes, rounds, [&parser](HarpoonDecoder&, const QByteArray& frame) {
+        SimdJsonObject root;
+        return SimdJsonObject::parse(parser, frame, root);
+    });
+    run("simdjson decode", frames, bytes, rounds, [&parser](HarpoonDecoder& decoder, const QByteArray& frame) {
+        SimdJsonObject root;
+        return SimdJsonObject::parse(parser, frame, root) && decoder.decode(root) != nullptr;
+    });
+#endif
+    return 0;
+}
@@ -0,0 +1,109 @@
+// Reconnects a HarpoonConnection to a local QWebSocketServer over and over
+// and reports the handshake times. With a certificate the server runs wss,
+// every reconnect then pays a full tls handshake.
+//
+//   reconnectbench [rounds] [cert.pem key.pem]
+//
+// The certificate must be issued for localhost, it is trusted as a CA here.
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QTimer>
+#include <QTextStream>
+#include <QWebSocketServer>
+#include <QWebSocket>
+#include <QHostAddress>
+#include <QSslConfiguration>
+#include <QSslCertificate>
+#include <QSslKey>
+#include <algorithm>
+#include <vector>
+
+#include "HarpoonConnection.hpp"
+
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+    QTextStream err(stderr);
+    int rounds = args.size() > 1 ? std::max(2, args[1].toInt()) : 50;
+    bool secure = args.size() > 3;
+
+    QWebSocketServer server("reconnectbench", secure ? QWebSocketServer::SecureMode : QWebSocketServer::NonSecureMode);
+    if (secure) {
+        QFile certFile(args[2]);
+        QFile keyFile(args[3]);
+        if (!certFile.open(QIODevice::ReadOnly) || !keyFile.open(QIODevice::ReadOnly)) {
+            err << "cannot read " << args[2] << " or " << args[3] << "\n";
+            return 1;
+        }
+        QSslCertificate cert(&certFile, QSsl::Pem);
+        QSslKey key(&keyFile, QSsl::Rsa, QSsl::Pem);
+
+        QSslConfiguration serverConfig = QSslConfiguration::defaultConfiguration();
+        serverConfig.setLocalCertificate(cert);
+        serverConfig.setPrivateKey(key);
+        serverConfig.setPeerVerifyMode(QSslSocket::VerifyNone);
+        server.setSslConfiguration(serverConfig);
+
+        // the client picks up the default configuration when it is created
+        QSslConfiguration clientConfig = QSslConfiguration::defaultConfiguration();
+        clientConfig.setCaCertificates(clientConfig.caCertificates() << cert);
+        QSslConfiguration::setDefaultConfiguration(clientConfig);
+    }
+    if (!server.listen(QHostAddress::LocalHost, 0)) {
+        err << "cannot listen: " << server.errorString() << "\n";
+        return 1;
+    }
+    QObject::connect(&server, &QWebSocketServer::newConnection, [&server] {
+            while (QWebSocket* socket = server.nextPendingConnection())
+                QObject::connect(socket, &QWebSocket::disconnected, socket, &QObject::deleteLater);
+        });
+
+    QUrl url;
+    url.setScheme(secure ? "wss" : "ws");
+    url.setHost("localhost");
+    url.setPort(server.serverPort());
+
+    HarpoonConnection connection;
+    std::vector<int> handshakes;
+    bool connected = false;
+    // queued, the connection must not be reentered from its own signal
+    QObject::connect(&connection, &HarpoonConnection::eventsAvailable, &app, [&] {
+            connection.acknowledgeEvents();
+            std::unique_ptr<HarpoonEvent> event;
+            while (connection.takeEvent(event)) {
+                if (event->type == HarpoonEventType::Connected) {
+                    connected = true;
+                    handshakes.push_back(static_cast<const ConnectedEvent&>(*event).handshakeTime);
+                    connection.close();
+                } else if (event->type == HarpoonEventType::Disconnected) {
+                    if (!connected) { // failed to connect, errors were logged
+                        app.exit(1);
+                        return;
+                    }
+                    connected = false;
+                    if (static_cast<int>(handshakes.size()) < rounds)
+                        connection.open(url);
+                    else
+                        app.quit();
+                }
+            }
+        }, Qt::QueuedConnection);
+    QTimer::singleShot(0, &connection, [&] { connection.open(url); });
+    if (app.exec() != 0)
+        return 1;
+
+    QTextStream out(stdout);
+    if (handshakes.size() < 2) {
+        out << "no reconnects completed\n";
+        return 1;
+    }
+    std::vector<int> reconnects(handshakes.begin() + 1, handshakes.end());
+    std::sort(reconnects.begin(), reconnects.end());
+    out << url.toString() << ": first handshake " << handshakes.front() << " ms, "
+        << reconnects.size() << " reconnects min " << reconnects.front()
+        << " median " << reconnects[reconnects.size() / 2]
+        << " max " << reconnects.back() << " ms\n";
+    return 0;
+}